@@ -1,5 +1,7 @@
 #pragma once
+#include <cstddef>
 #include <cstdint>
+#include <atomic>
 
 #define MAX_JOYSTICKS          2
 #define MAX_TRIGGERS           2
@@ -62,4 +64,82 @@ struct ControllerConfig
     RGBAColor buttonsColor{0, 0, 0, 255};
     RGBAColor leftGripColor{70, 70, 70, 255};
     RGBAColor rightGripColor{70, 70, 70, 255};
+};
+
+// A config handed out by SharedControllerConfig. The buffer it refers to isn't written while it is held,
+// so it is only kept for one frame, a Set waits for it
+class ControllerConfigRef
+{
+public:
+    ControllerConfigRef(const ControllerConfig *config, std::atomic<uint32_t> *readers)
+        : m_config(config), m_readers(readers)
+    {
+    }
+
+    ControllerConfigRef(ControllerConfigRef &&other)
+        : m_config(other.m_config), m_readers(other.m_readers)
+    {
+        other.m_readers = nullptr;
+    }
+
+    ~ControllerConfigRef()
+    {
+        if (m_readers != nullptr)
+            m_readers->fetch_sub(1, std::memory_order_release);
+    }
+
+    ControllerConfigRef(const ControllerConfigRef &) = delete;
+    ControllerConfigRef &operator=(const ControllerConfigRef &) = delete;
+    ControllerConfigRef &operator=(ControllerConfigRef &&) = delete;
+
+    inline const ControllerConfig &operator*() const { return *m_config; }
+    inline const ControllerConfig *operator->() const { return m_config; }
+
+private:
+    const ControllerConfig *m_config;
+    std::atomic<uint32_t> *m_readers;
+};
+
+// A config that can be replaced while the input threads are reading it. The new config is written to the buffer
+// that isn't in use and published with a single pointer store. Readers pin the buffer they were handed, which is
+// retried if it stopped being the current one meanwhile: two Sets in a row would otherwise overwrite it while in use.
+// Readers never wait on a Set in progress, a Set waits for the readers of the buffer it is about to write.
+// Writers must be serialized by the caller
+class SharedControllerConfig
+{
+public:
+    ControllerConfigRef Get() const
+    {
+        while (true)
+        {
+            const ControllerConfig *current = m_current.load(std::memory_order_seq_cst);
+            std::atomic<uint32_t> &readers = m_readers[current - m_buffers];
+
+            // A Set that already looked at this buffer's readers has published the other one by now, which is caught here
+            readers.fetch_add(1, std::memory_order_seq_cst);
+            if (m_current.load(std::memory_order_seq_cst) == current)
+                return ControllerConfigRef(current, &readers);
+            readers.fetch_sub(1, std::memory_order_release);
+        }
+    }
+
+    void Set(const ControllerConfig &config)
+    {
+        const ControllerConfig *current = m_current.load(std::memory_order_relaxed);
+        size_t next = current == &m_buffers[0] ? 1 : 0;
+
+        // Readers only hold on for a frame, and new ones back off as the buffer isn't the current one
+        while (m_readers[next].load(std::memory_order_seq_cst) != 0)
+        {
+        }
+
+        m_buffers[next] = config;
+        m_current.store(&m_buffers[next], std::memory_order_seq_cst);
+    }
+
+private:
+    ControllerConfig m_buffers[2]{};
+    std::atomic<const ControllerConfig *> m_current{&m_buffers[0]};
+    // Readers holding a ControllerConfigRef to each buffer
+    mutable std::atomic<uint32_t> m_readers[2]{};
 };
\ No newline at end of file
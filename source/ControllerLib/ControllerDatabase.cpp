@@ -0,0 +1,197 @@
+#include "ControllerDatabase.h"
+#include <algorithm>
+#include <iterator>
+#include <stratosphere.hpp>
+
+namespace
+{
+    constexpr uint32_t MakeKey(uint16_t vendor_id, uint16_t product_id)
+    {
+        return (static_cast<uint32_t>(vendor_id) << 16) | product_id;
+    }
+
+    constexpr uint32_t MakeKey(const DeviceEntry &entry)
+    {
+        return MakeKey(entry.id.vendor_id, entry.id.product_id);
+    }
+
+    // Must be kept sorted by vendor id, then product id. This is checked at compile time below.
+    // got many from real hardware. And a lot from here:
+    // https://github.com/Raphfriend/USB2DB15/blob/master/RFUSB_to_DB15/drivers.h#L39
+    constexpr DeviceEntry devices[] = {
+        {{0x0079, 0x181a}, CONTROLLER_DUALSHOCK3, DEVICE_QUIRK_NONE},                                      // venom
+        {{0x0079, 0x181b}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Venom Arcade Stick
+        {{0x045e, 0x028e}, CONTROLLER_XBOX360, DEVICE_QUIRK_NONE},                                         // Xbox 360 Controller
+        {{0x045e, 0x02d1}, CONTROLLER_XBOXONE, DEVICE_QUIRK_NONE},                                         // Xbox One Controller
+        {{0x045e, 0x02dd}, CONTROLLER_XBOXONE, DEVICE_QUIRK_NONE},                                         // Xbox One Controller (Firmware 2015)
+        {{0x045e, 0x02e3}, CONTROLLER_XBOXONE, DEVICE_QUIRK_NONE},                                         // Xbox One Elite Controller
+        {{0x045e, 0x02ea}, CONTROLLER_XBOXONE, DEVICE_QUIRK_NONE},                                         // Xbox One S Controller
+        {{0x045e, 0x0719}, CONTROLLER_XBOX360W, DEVICE_QUIRK_NONE},                                        // Xbox 360 Wireless Receiver
+        {{0x045e, 0x0b0a}, CONTROLLER_XBOXONE, DEVICE_QUIRK_NONE},                                         // Xbox Adaptive Controller
+        {{0x054c, 0x0268}, CONTROLLER_DUALSHOCK3, DEVICE_QUIRK_NONE},                                      // DS3
+        {{0x054c, 0x05c4}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // DS4 v1
+        {{0x054c, 0x09cc}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // DS4 v2
+        {{0x054c, 0x0ba0}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // PS4 wireless Adapter
+        {{0x0738, 0x8180}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Mad Catz Fight Stick Alpha
+        {{0x0738, 0x8250}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Mad Catz FightPad PRO PS4
+        {{0x0738, 0x8384}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Mad Catz SFV Arcade FightStick TES+
+        {{0x0738, 0x8481}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Mad Catz SFV Arcade FightStick TE2+
+        {{0x0c12, 0x0c30}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Brooks Universal Fighting Board (PS4 mode)
+        {{0x0c12, 0x0e31}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Brooks PS4 Audio Board
+        {{0x0c12, 0x0ef1}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Brooks PS2 -> PS4 Adapter
+        {{0x0c12, 0x0ef7}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Brooks tiny square PS4 Board
+        {{0x0c12, 0x0ef8}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Brooks Fighting Board
+        {{0x0c12, 0x1cf2}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Brooks PS3 -> PS4 Adapter
+        {{0x0e6f, 0x0000}, CONTROLLER_XBOXONE, DEVICE_QUIRK_XBONE_PDP_INIT},                               // PDP Xbox One controllers
+        {{0x0e6f, 0x0165}, CONTROLLER_XBOXONE, DEVICE_QUIRK_XBONE_HORI_INIT | DEVICE_QUIRK_XBONE_PDP_INIT}, // PDP, needs the Hori init too
+        {{0x0f0d, 0x0022}, CONTROLLER_DUALSHOCK3, DEVICE_QUIRK_NONE},                                      // Hori Co., Ltd
+        {{0x0f0d, 0x0067}, CONTROLLER_XBOXONE, DEVICE_QUIRK_XBONE_HORI_INIT},                              // HORIPAD ONE
+        {{0x0f0d, 0x006f}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // HORI RAP Pro VLX
+        {{0x0f0d, 0x0084}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Hori Fighting Commander v4
+        {{0x0f0d, 0x0085}, CONTROLLER_DUALSHOCK3, DEVICE_QUIRK_NONE},                                      // Hori Fighting Commander v4
+        {{0x0f0d, 0x0087}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Hori Mini Arcade Stick
+        {{0x0f0d, 0x0088}, CONTROLLER_DUALSHOCK3, DEVICE_QUIRK_NONE},                                      // hori mini Arcade Stick
+        {{0x0f0d, 0x008a}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // HORI RAP V Hayabusa
+        {{0x0f0d, 0x00ae}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Hori RAP Pro N Hayabusa
+        {{0x0f0d, 0x00ee}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // HORI ワイヤードコントローラライト for PS4-102
+        {{0x146b, 0x0d09}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Nacon Daija
+        {{0x1532, 0x0401}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Razer Panthera
+        {{0x1532, 0x0402}, CONTROLLER_DUALSHOCK3, DEVICE_QUIRK_NONE},                                      // Razer Panthera
+        {{0x1532, 0x1004}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Razer Raiju Ultimate
+        {{0x1532, 0x1008}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Razer Panthera EVO
+        {{0x1c1a, 0x0100}, CONTROLLER_DUALSHOCK3, DEVICE_QUIRK_NONE},                                      // datel Arcade Stick
+        {{0x1f4f, 0x1002}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Xrd PS4 Pad
+        {{0x24c6, 0x0000}, CONTROLLER_XBOXONE, DEVICE_QUIRK_XBONE_RUMBLE_INIT},                            // PowerA Xbox One controllers
+        {{0x2c22, 0x2000}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Qanba Drone
+        {{0x2c22, 0x2200}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Qanba Crystal
+        {{0x2c22, 0x2300}, CONTROLLER_DUALSHOCK4, DEVICE_QUIRK_NONE},                                      // Qanba Obsidian
+    };
+
+    // hori fighting command in pc mode (0x0f0d, 0x0086)
+
+    static_assert(std::is_sorted(std::begin(devices), std::end(devices), [](const DeviceEntry &a, const DeviceEntry &b) {
+                      return MakeKey(a) < MakeKey(b);
+                  }) && std::adjacent_find(std::begin(devices), std::end(devices), [](const DeviceEntry &a, const DeviceEntry &b) {
+                      return MakeKey(a) == MakeKey(b);
+                  }) == std::end(devices),
+                  "devices must be sorted by vendor and product id, with no duplicates");
+
+    const DeviceEntry *FindBuiltIn(uint32_t key)
+    {
+        const DeviceEntry *it = std::lower_bound(std::begin(devices), std::end(devices), key, [](const DeviceEntry &entry, uint32_t key) {
+            return MakeKey(entry) < key;
+        });
+
+        if (it == std::end(devices) || MakeKey(*it) != key)
+            return nullptr;
+
+        return it;
+    }
+
+    // Open addressing hash table, kept at most half full. A vendor id of 0 marks an empty slot.
+    struct UserDeviceIndex
+    {
+        static constexpr size_t Capacity = MaxUserDevices * 2;
+        static_assert((Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+        DeviceEntry entries[Capacity];
+        size_t count;
+    };
+
+    UserDeviceIndex g_userDevices{};
+    UserDeviceIndex g_pendingUserDevices{};
+    ams::os::Mutex g_userDevicesMutex(false);
+
+    size_t HashKey(uint32_t key)
+    {
+        return ((key * 0x9E3779B1u) >> 16) & (UserDeviceIndex::Capacity - 1);
+    }
+
+    bool InterfaceMatches(const DeviceEntry &entry, uint8_t interface_number)
+    {
+        return entry.interface_number == DeviceAnyInterface || interface_number == DeviceAnyInterface || entry.interface_number == interface_number;
+    }
+
+    // Must be called with g_userDevicesMutex held
+    bool FindUser(uint32_t key, uint8_t interface_number, DeviceEntry *outEntry)
+    {
+        for (size_t i = HashKey(key), probes = 0; probes != UserDeviceIndex::Capacity; i = (i + 1) & (UserDeviceIndex::Capacity - 1), ++probes)
+        {
+            const DeviceEntry &entry = g_userDevices.entries[i];
+            if (entry.id.vendor_id == 0)
+                return false;
+
+            if (MakeKey(entry) == key && InterfaceMatches(entry, interface_number))
+            {
+                *outEntry = entry;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool FindExact(uint32_t key, uint8_t interface_number, DeviceEntry *outEntry)
+    {
+        {
+            std::scoped_lock lock(g_userDevicesMutex);
+            if (g_userDevices.count != 0 && FindUser(key, interface_number, outEntry))
+                return true;
+        }
+
+        if (const DeviceEntry *entry = FindBuiltIn(key))
+        {
+            *outEntry = *entry;
+            return true;
+        }
+        return false;
+    }
+} // namespace
+
+bool FindDeviceEntry(uint16_t vendor_id, uint16_t product_id, uint8_t interface_number, DeviceEntry *outEntry)
+{
+    if (FindExact(MakeKey(vendor_id, product_id), interface_number, outEntry))
+        return true;
+
+    return FindExact(MakeKey(vendor_id, 0), interface_number, outEntry);
+}
+
+uint8_t GetDeviceQuirks(uint16_t vendor_id, uint16_t product_id)
+{
+    DeviceEntry entry;
+    return FindDeviceEntry(vendor_id, product_id, DeviceAnyInterface, &entry) ? entry.quirks : DEVICE_QUIRK_NONE;
+}
+
+void BeginUserDevices()
+{
+    g_pendingUserDevices = UserDeviceIndex{};
+}
+
+bool AddUserDevice(const DeviceEntry &entry)
+{
+    if (entry.id.vendor_id == 0 || g_pendingUserDevices.count == MaxUserDevices)
+        return false;
+
+    uint32_t key = MakeKey(entry);
+    size_t i = HashKey(key);
+    while (g_pendingUserDevices.entries[i].id.vendor_id != 0)
+    {
+        // A later entry for the same device and interface replaces the earlier one
+        DeviceEntry &existing = g_pendingUserDevices.entries[i];
+        if (MakeKey(existing) == key && existing.interface_number == entry.interface_number)
+        {
+            existing = entry;
+            return true;
+        }
+        i = (i + 1) & (UserDeviceIndex::Capacity - 1);
+    }
+
+    g_pendingUserDevices.entries[i] = entry;
+    ++g_pendingUserDevices.count;
+    return true;
+}
+
+void CommitUserDevices()
+{
+    std::scoped_lock lock(g_userDevicesMutex);
+    g_userDevices = g_pendingUserDevices;
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+#include "ControllerTypes.h"
+#include <cstddef>
+
+// Device specific behaviour that can't be told apart by the interface descriptors alone
+enum DeviceQuirk : uint8_t
+{
+    DEVICE_QUIRK_NONE = 0,
+    DEVICE_QUIRK_XBONE_HORI_INIT = 1 << 0,   // Needs the Hori init packet before anything else
+    DEVICE_QUIRK_XBONE_PDP_INIT = 1 << 1,    // Needs the PDP init packets
+    DEVICE_QUIRK_XBONE_RUMBLE_INIT = 1 << 2, // Needs a rumble begin/end sequence to start sending input
+};
+
+constexpr uint8_t DeviceAnyInterface = 0xFF;
+
+struct DeviceEntry
+{
+    HardwareId id; // A product id of 0 matches every product of the vendor
+    ControllerType type;
+    uint8_t quirks;
+    uint8_t interface_number = DeviceAnyInterface;
+};
+
+// How many devices can be added on top of the built-in ones
+constexpr size_t MaxUserDevices = 64;
+
+// Look up a device by its vendor and product id, and its interface number (DeviceAnyInterface if it doesn't matter).
+// User devices take priority over built-in ones, and exact matches over vendor-wide entries.
+// Doesn't allocate, so it's safe to call from the USB event path. Returns false if the device is unknown.
+bool FindDeviceEntry(uint16_t vendor_id, uint16_t product_id, uint8_t interface_number, DeviceEntry *outEntry);
+
+// Shorthand for the device's quirks, DEVICE_QUIRK_NONE if it's unknown
+uint8_t GetDeviceQuirks(uint16_t vendor_id, uint16_t product_id);
+
+// Replacing the user devices is done in three steps so that a lookup never sees a half built index.
+// Only one thread may be building at a time.
+void BeginUserDevices();
+bool AddUserDevice(const DeviceEntry &entry); // Returns false if the index is full or the entry is invalid
+void CommitUserDevices();
\ No newline at end of file
@@ -5,6 +5,7 @@ bool DoesControllerSupport(ControllerType type, ControllerSupport supportType)
     switch (type)
     {
     case CONTROLLER_XBOX360:
+    case CONTROLLER_XBOXORIG:
         if (supportType == SUPPORTS_RUMBLE)
             return true;
         return false;
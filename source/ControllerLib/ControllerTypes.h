@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 
 struct HardwareId {
     uint16_t vendor_id;
@@ -14,6 +15,7 @@ enum ControllerType : uint8_t
     CONTROLLER_XBOXONEW,
     CONTROLLER_DUALSHOCK3,
     CONTROLLER_DUALSHOCK4,
+    CONTROLLER_XBOXORIG,
 };
 
 enum VendorIDs : uint16_t
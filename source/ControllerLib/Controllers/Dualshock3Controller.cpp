@@ -1,10 +1,14 @@
 #include "Controllers/Dualshock3Controller.h"
 #include <cmath>
+#include <cstring>
+#include <algorithm>
 
-static ControllerConfig _dualshock3ControllerConfig{};
+static SharedControllerConfig _dualshock3ControllerConfig;
+
+static constexpr uint8_t ds3_start_device_bytes[] = {0x42, 0x0C, 0x00, 0x00};
 
 Dualshock3Controller::Dualshock3Controller(std::unique_ptr<IUSBDevice> &&interface)
-    : IController(std::move(interface))
+    : IController(std::move(interface), &_dualshock3ControllerConfig)
 {
 }
 
@@ -26,6 +30,15 @@ void Dualshock3Controller::Exit()
     CloseInterfaces();
 }
 
+ams::Result Dualshock3Controller::Resume()
+{
+    R_TRY(SendCommand(m_interface, Ds3FeatureStartDevice, ds3_start_device_bytes, sizeof(ds3_start_device_bytes)));
+
+    SetLED(DS3LED_1);
+
+    R_SUCCEED();
+}
+
 ams::Result Dualshock3Controller::OpenInterfaces()
 {
     R_TRY(m_device->Open());
@@ -46,8 +59,7 @@ ams::Result Dualshock3Controller::OpenInterfaces()
             continue;
 
         // Send an initial control packet
-        constexpr uint8_t initBytes[] = {0x42, 0x0C, 0x00, 0x00};
-        R_TRY(SendCommand(interface.get(), Ds3FeatureStartDevice, initBytes, sizeof(initBytes)));
+        R_TRY(SendCommand(interface.get(), Ds3FeatureStartDevice, ds3_start_device_bytes, sizeof(ds3_start_device_bytes)));
 
         m_interface = interface.get();
 
@@ -96,13 +108,16 @@ void Dualshock3Controller::CloseInterfaces()
 
 ams::Result Dualshock3Controller::GetInput()
 {
-    uint8_t input_bytes[49];
+    uint8_t input_bytes[49]{};
+    size_t size;
 
-    R_TRY(m_inPipe->Read(input_bytes, sizeof(input_bytes)));
+    R_TRY(m_inPipe->Read(input_bytes, sizeof(input_bytes), &size));
 
-    if (input_bytes[0] == Ds3InputPacket_Button)
+    static_assert(sizeof(Dualshock3ButtonData) <= sizeof(input_bytes));
+    // A stick at 0 is fully deflected, so a short report is dropped instead of being padded out
+    if (size >= sizeof(m_buttonData) && input_bytes[0] == Ds3InputPacket_Button)
     {
-        m_buttonData = *reinterpret_cast<Dualshock3ButtonData *>(input_bytes);
+        std::memcpy(&m_buttonData, input_bytes, sizeof(m_buttonData));
     }
 
     R_SUCCEED();
@@ -154,14 +169,15 @@ void Dualshock3Controller::NormalizeAxis(uint8_t x,
 // Pass by value should hopefully be optimized away by RVO
 NormalizedButtonData Dualshock3Controller::GetNormalizedButtonData()
 {
+    const ControllerConfigRef config = GetConfig();
     NormalizedButtonData normalData{};
 
-    normalData.triggers[0] = NormalizeTrigger(_dualshock3ControllerConfig.triggerDeadzonePercent[0], m_buttonData.trigger_left_pressure);
-    normalData.triggers[1] = NormalizeTrigger(_dualshock3ControllerConfig.triggerDeadzonePercent[1], m_buttonData.trigger_right_pressure);
+    normalData.triggers[0] = NormalizeTrigger(config->triggerDeadzonePercent[0], m_buttonData.trigger_left_pressure);
+    normalData.triggers[1] = NormalizeTrigger(config->triggerDeadzonePercent[1], m_buttonData.trigger_right_pressure);
 
-    NormalizeAxis(m_buttonData.stick_left_x, m_buttonData.stick_left_y, _dualshock3ControllerConfig.stickDeadzonePercent[0],
+    NormalizeAxis(m_buttonData.stick_left_x, m_buttonData.stick_left_y, config->stickDeadzonePercent[0],
                   &normalData.sticks[0].axis_x, &normalData.sticks[0].axis_y);
-    NormalizeAxis(m_buttonData.stick_right_x, m_buttonData.stick_right_y, _dualshock3ControllerConfig.stickDeadzonePercent[1],
+    NormalizeAxis(m_buttonData.stick_right_x, m_buttonData.stick_right_y, config->stickDeadzonePercent[1],
                   &normalData.sticks[1].axis_x, &normalData.sticks[1].axis_y);
 
     bool buttons[MAX_CONTROLLER_BUTTONS] = {
@@ -187,7 +203,7 @@ NormalizedButtonData Dualshock3Controller::GetNormalizedButtonData()
 
     for (int i = 0; i != MAX_CONTROLLER_BUTTONS; ++i)
     {
-        ControllerButton button = _dualshock3ControllerConfig.buttons[i];
+        ControllerButton button = config->buttons[i];
         if (button == NONE)
             continue;
 
@@ -225,10 +241,5 @@ ams::Result Dualshock3Controller::SetLED(Dualshock3LEDValue value)
 
 void Dualshock3Controller::LoadConfig(const ControllerConfig *config)
 {
-    _dualshock3ControllerConfig = *config;
-}
-
-ControllerConfig *Dualshock3Controller::GetConfig()
-{
-    return &_dualshock3ControllerConfig;
+    _dualshock3ControllerConfig.Set(*config);
 }
\ No newline at end of file
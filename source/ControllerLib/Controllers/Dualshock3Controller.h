@@ -134,6 +134,7 @@ public:
 
     virtual ams::Result Initialize() override;
     virtual void Exit() override;
+    virtual ams::Result Resume() override;
 
     ams::Result OpenInterfaces();
     void CloseInterfaces();
@@ -157,5 +158,4 @@ public:
     ams::Result SetLED(Dualshock3LEDValue value);
 
     static void LoadConfig(const ControllerConfig *config);
-    virtual ControllerConfig *GetConfig() override;
 };
\ No newline at end of file
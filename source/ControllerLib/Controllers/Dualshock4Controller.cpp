@@ -1,13 +1,15 @@
 #include "Controllers/Dualshock4Controller.h"
 #include <cmath>
+#include <cstring>
+#include <algorithm>
 
 #include "../Sysmodule/source/log.h"
 
-static ControllerConfig _dualshock4ControllerConfig{};
+static SharedControllerConfig _dualshock4ControllerConfig;
 static RGBAColor _ledValue{0x00, 0x00, 0x40};
 
 Dualshock4Controller::Dualshock4Controller(std::unique_ptr<IUSBDevice> &&interface)
-    : IController(std::move(interface))
+    : IController(std::move(interface), &_dualshock4ControllerConfig)
 {
 }
 
@@ -40,16 +42,21 @@ void Dualshock4Controller::Exit()
     CloseInterfaces();
 }
 
+ams::Result Dualshock4Controller::Resume()
+{
+    R_RETURN(SendInitBytes());
+}
+
 ams::Result Dualshock4Controller::OpenInterfaces()
 {
-    WriteToLog("Opening device...");
+    LOG_DEBUG("Opening device...");
     R_TRY(m_device->Open());
 
     // Open each interface, send it a setup packet and get the endpoints if it succeeds
     std::vector<std::unique_ptr<IUSBInterface>> &interfaces = m_device->GetInterfaces();
     for (auto &&interface : interfaces)
     {
-        WriteToLog("Opening interface...");
+        LOG_DEBUG("Opening interface...");
         R_TRY(interface->Open());
 
         if (interface->GetDescriptor()->bInterfaceClass != 3)
@@ -68,7 +75,7 @@ ams::Result Dualshock4Controller::OpenInterfaces()
                 IUSBEndpoint *inEndpoint = interface->GetEndpoint(IUSBEndpoint::USB_ENDPOINT_IN, i);
                 if (inEndpoint)
                 {
-                    WriteToLog("Opening input endpoint...");
+                    LOG_DEBUG("Opening input endpoint...");
                     R_TRY(inEndpoint->Open());
 
                     m_inPipe = inEndpoint;
@@ -84,7 +91,7 @@ ams::Result Dualshock4Controller::OpenInterfaces()
                 IUSBEndpoint *outEndpoint = interface->GetEndpoint(IUSBEndpoint::USB_ENDPOINT_OUT, i);
                 if (outEndpoint)
                 {
-                    WriteToLog("Opening output endpoint...");
+                    LOG_DEBUG("Opening output endpoint...");
                     R_TRY(outEndpoint->Open());
 
                     m_outPipe = outEndpoint;
@@ -97,7 +104,7 @@ ams::Result Dualshock4Controller::OpenInterfaces()
     if (!m_inPipe || !m_outPipe)
         R_RETURN(69);
 
-    WriteToLog("Success");
+    LOG_DEBUG("Success");
     R_SUCCEED();
 }
 
@@ -110,13 +117,16 @@ void Dualshock4Controller::CloseInterfaces()
 ams::Result Dualshock4Controller::GetInput()
 {
 
-    uint8_t input_bytes[64];
+    uint8_t input_bytes[64]{};
+    size_t size;
 
-    R_TRY(m_inPipe->Read(input_bytes, sizeof(input_bytes)));
+    R_TRY(m_inPipe->Read(input_bytes, sizeof(input_bytes), &size));
 
-    if (input_bytes[0] == 0x01)
+    static_assert(sizeof(Dualshock4USBButtonData) <= sizeof(input_bytes));
+    // A stick at 0 is fully deflected, so a short report is dropped instead of being padded out
+    if (size >= sizeof(m_buttonData) && input_bytes[0] == 0x01)
     {
-        m_buttonData = *reinterpret_cast<Dualshock4USBButtonData *>(input_bytes);
+        std::memcpy(&m_buttonData, input_bytes, sizeof(m_buttonData));
     }
 
     R_SUCCEED();
@@ -168,14 +178,15 @@ void Dualshock4Controller::NormalizeAxis(uint8_t x,
 // Pass by value should hopefully be optimized away by RVO
 NormalizedButtonData Dualshock4Controller::GetNormalizedButtonData()
 {
+    const ControllerConfigRef config = GetConfig();
     NormalizedButtonData normalData{};
 
-    normalData.triggers[0] = NormalizeTrigger(_dualshock4ControllerConfig.triggerDeadzonePercent[0], m_buttonData.l2_pressure);
-    normalData.triggers[1] = NormalizeTrigger(_dualshock4ControllerConfig.triggerDeadzonePercent[1], m_buttonData.r2_pressure);
+    normalData.triggers[0] = NormalizeTrigger(config->triggerDeadzonePercent[0], m_buttonData.l2_pressure);
+    normalData.triggers[1] = NormalizeTrigger(config->triggerDeadzonePercent[1], m_buttonData.r2_pressure);
 
-    NormalizeAxis(m_buttonData.stick_left_x, m_buttonData.stick_left_y, _dualshock4ControllerConfig.stickDeadzonePercent[0],
+    NormalizeAxis(m_buttonData.stick_left_x, m_buttonData.stick_left_y, config->stickDeadzonePercent[0],
                   &normalData.sticks[0].axis_x, &normalData.sticks[0].axis_y);
-    NormalizeAxis(m_buttonData.stick_right_x, m_buttonData.stick_right_y, _dualshock4ControllerConfig.stickDeadzonePercent[1],
+    NormalizeAxis(m_buttonData.stick_right_x, m_buttonData.stick_right_y, config->stickDeadzonePercent[1],
                   &normalData.sticks[1].axis_x, &normalData.sticks[1].axis_y);
 
     bool buttons[MAX_CONTROLLER_BUTTONS] = {
@@ -203,7 +214,7 @@ NormalizedButtonData Dualshock4Controller::GetNormalizedButtonData()
 
     for (int i = 0; i != MAX_CONTROLLER_BUTTONS; ++i)
     {
-        ControllerButton button = _dualshock4ControllerConfig.buttons[i];
+        ControllerButton button = config->buttons[i];
         if (button == NONE)
             continue;
 
@@ -224,11 +235,6 @@ ams::Result Dualshock4Controller::SetRumble(uint8_t strong_magnitude, uint8_t we
 
 void Dualshock4Controller::LoadConfig(const ControllerConfig *config, RGBAColor ledValue)
 {
-    _dualshock4ControllerConfig = *config;
+    _dualshock4ControllerConfig.Set(*config);
     _ledValue = ledValue;
-}
-
-ControllerConfig *Dualshock4Controller::GetConfig()
-{
-    return &_dualshock4ControllerConfig;
 }
\ No newline at end of file
@@ -152,6 +152,7 @@ public:
 
     virtual ams::Result Initialize() override;
     virtual void Exit() override;
+    virtual ams::Result Resume() override;
 
     ams::Result OpenInterfaces();
     void CloseInterfaces();
@@ -169,5 +170,4 @@ public:
     ams::Result SetRumble(uint8_t strong_magnitude, uint8_t weak_magnitude);
 
     static void LoadConfig(const ControllerConfig *config, RGBAColor ledValue);
-    virtual ControllerConfig *GetConfig() override;
 };
\ No newline at end of file
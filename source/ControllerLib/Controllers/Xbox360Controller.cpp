@@ -1,10 +1,12 @@
 #include "Controllers/Xbox360Controller.h"
 #include <cmath>
+#include <cstring>
+#include <algorithm>
 
-static ControllerConfig _xbox360ControllerConfig{};
+static SharedControllerConfig _xbox360ControllerConfig;
 
 Xbox360Controller::Xbox360Controller(std::unique_ptr<IUSBDevice> &&interface)
-    : IController(std::move(interface))
+    : IController(std::move(interface), &_xbox360ControllerConfig)
 {
 }
 
@@ -26,6 +28,11 @@ void Xbox360Controller::Exit()
     CloseInterfaces();
 }
 
+ams::Result Xbox360Controller::Resume()
+{
+    R_RETURN(SetLED(XBOX360LED_TOPLEFT));
+}
+
 ams::Result Xbox360Controller::OpenInterfaces()
 {
     R_TRY(m_device->Open());
@@ -87,15 +94,18 @@ void Xbox360Controller::CloseInterfaces()
 
 ams::Result Xbox360Controller::GetInput()
 {
-    uint8_t input_bytes[64];
+    uint8_t input_bytes[64]{};
+    size_t size;
 
-    R_TRY(m_inPipe->Read(input_bytes, sizeof(input_bytes)));
+    R_TRY(m_inPipe->Read(input_bytes, sizeof(input_bytes), &size));
 
     uint8_t type = input_bytes[0];
 
-    if (type == XBOX360INPUT_BUTTON) // Button data
+    static_assert(sizeof(Xbox360ButtonData) <= sizeof(input_bytes));
+    // input_bytes is zeroed past the end of the report, so a short one never leaves fields of the previous one behind
+    if (size != 0 && type == XBOX360INPUT_BUTTON) // Button data
     {
-        m_buttonData = *reinterpret_cast<Xbox360ButtonData *>(input_bytes);
+        std::memcpy(&m_buttonData, input_bytes, sizeof(m_buttonData));
     }
 
     R_SUCCEED();
@@ -157,14 +167,15 @@ void Xbox360Controller::NormalizeAxis(int16_t x,
 // Pass by value should hopefully be optimized away by RVO
 NormalizedButtonData Xbox360Controller::GetNormalizedButtonData()
 {
+    const ControllerConfigRef config = GetConfig();
     NormalizedButtonData normalData{};
 
-    normalData.triggers[0] = NormalizeTrigger(_xbox360ControllerConfig.triggerDeadzonePercent[0], m_buttonData.trigger_left);
-    normalData.triggers[1] = NormalizeTrigger(_xbox360ControllerConfig.triggerDeadzonePercent[1], m_buttonData.trigger_right);
+    normalData.triggers[0] = NormalizeTrigger(config->triggerDeadzonePercent[0], m_buttonData.trigger_left);
+    normalData.triggers[1] = NormalizeTrigger(config->triggerDeadzonePercent[1], m_buttonData.trigger_right);
 
-    NormalizeAxis(m_buttonData.stick_left_x, m_buttonData.stick_left_y, _xbox360ControllerConfig.stickDeadzonePercent[0],
+    NormalizeAxis(m_buttonData.stick_left_x, m_buttonData.stick_left_y, config->stickDeadzonePercent[0],
                   &normalData.sticks[0].axis_x, &normalData.sticks[0].axis_y);
-    NormalizeAxis(m_buttonData.stick_right_x, m_buttonData.stick_right_y, _xbox360ControllerConfig.stickDeadzonePercent[1],
+    NormalizeAxis(m_buttonData.stick_right_x, m_buttonData.stick_right_y, config->stickDeadzonePercent[1],
                   &normalData.sticks[1].axis_x, &normalData.sticks[1].axis_y);
 
     bool buttons[MAX_CONTROLLER_BUTTONS]{
@@ -190,7 +201,7 @@ NormalizedButtonData Xbox360Controller::GetNormalizedButtonData()
 
     for (int i = 0; i != MAX_CONTROLLER_BUTTONS; ++i)
     {
-        ControllerButton button = _xbox360ControllerConfig.buttons[i];
+        ControllerButton button = config->buttons[i];
         if (button == NONE)
             continue;
 
@@ -214,10 +225,5 @@ ams::Result Xbox360Controller::SetLED(Xbox360LEDValue value)
 
 void Xbox360Controller::LoadConfig(const ControllerConfig *config)
 {
-    _xbox360ControllerConfig = *config;
-}
-
-ControllerConfig *Xbox360Controller::GetConfig()
-{
-    return &_xbox360ControllerConfig;
+    _xbox360ControllerConfig.Set(*config);
 }
\ No newline at end of file
@@ -94,6 +94,7 @@ public:
 
     virtual ams::Result Initialize() override;
     virtual void Exit() override;
+    virtual ams::Result Resume() override;
 
     ams::Result OpenInterfaces();
     void CloseInterfaces();
@@ -115,5 +116,4 @@ public:
     ams::Result SetLED(Xbox360LEDValue value);
 
     static void LoadConfig(const ControllerConfig *config);
-    virtual ControllerConfig *GetConfig() override;
 };
\ No newline at end of file
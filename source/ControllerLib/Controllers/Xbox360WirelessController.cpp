@@ -1,14 +1,16 @@
 #include "Controllers/Xbox360WirelessController.h"
 #include <cmath>
+#include <cstring>
+#include <algorithm>
 
-static ControllerConfig _xbox360WControllerConfig{};
+static SharedControllerConfig _xbox360WControllerConfig;
 static constexpr uint8_t reconnectPacket[]{0x08, 0x00, 0x0F, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
 static constexpr uint8_t poweroffPacket[]{0x00, 0x00, 0x08, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
 static constexpr uint8_t initDriverPacket[]{0x00, 0x00, 0x02, 0x80, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
 static constexpr uint8_t ledPacketOn[]{0x00, 0x00, 0x08, 0x40 | XBOX360LED_TOPLEFT, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00};
 
 Xbox360WirelessController::Xbox360WirelessController(std::unique_ptr<IUSBDevice> &&interface)
-    : IController(std::move(interface))
+    : IController(std::move(interface), &_xbox360WControllerConfig)
 {
 }
 
@@ -35,6 +37,15 @@ void Xbox360WirelessController::Exit()
     CloseInterfaces();
 }
 
+ams::Result Xbox360WirelessController::Resume()
+{
+    // The connect packets are sent by the output thread once it's running again
+    if (m_presence)
+        R_RETURN(OnControllerConnect());
+
+    R_RETURN(WriteToEndpoint(reconnectPacket, sizeof(reconnectPacket)));
+}
+
 ams::Result Xbox360WirelessController::OpenInterfaces()
 {
     R_TRY(m_device->Open());
@@ -99,9 +110,11 @@ void Xbox360WirelessController::CloseInterfaces()
 
 ams::Result Xbox360WirelessController::GetInput()
 {
-    uint8_t input_bytes[64];
+    // Zeroed so that the header checks below never look at stale bytes of a short report
+    uint8_t input_bytes[64]{};
+    size_t size;
 
-    R_TRY(m_inPipe->Read(input_bytes, sizeof(input_bytes)));
+    R_TRY(m_inPipe->Read(input_bytes, sizeof(input_bytes), &size));
 
     uint8_t type = input_bytes[0];
 
@@ -120,12 +133,15 @@ ams::Result Xbox360WirelessController::GetInput()
         }
     }
 
+    // Not an input report, there is nothing new to process but the read itself went fine
     if (input_bytes[1] != 0x1)
-        R_RETURN(1);
+        R_SUCCEED();
 
-    if (type == XBOX360INPUT_BUTTON)
+    static_assert(sizeof(Xbox360ButtonData) + 4 <= sizeof(input_bytes));
+    // input_bytes is zeroed past the end of the report, so a short one never leaves fields of the previous one behind
+    if (size > 4 && type == XBOX360INPUT_BUTTON)
     {
-        m_buttonData = *reinterpret_cast<Xbox360ButtonData *>(input_bytes + 4);
+        std::memcpy(&m_buttonData, input_bytes + 4, sizeof(m_buttonData));
     }
 
     R_SUCCEED();
@@ -178,14 +194,15 @@ void Xbox360WirelessController::NormalizeAxis(int16_t x,
 // Pass by value should hopefully be optimized away by RVO
 NormalizedButtonData Xbox360WirelessController::GetNormalizedButtonData()
 {
+    const ControllerConfigRef config = GetConfig();
     NormalizedButtonData normalData{};
 
-    normalData.triggers[0] = NormalizeTrigger(_xbox360WControllerConfig.triggerDeadzonePercent[0], m_buttonData.trigger_left);
-    normalData.triggers[1] = NormalizeTrigger(_xbox360WControllerConfig.triggerDeadzonePercent[1], m_buttonData.trigger_right);
+    normalData.triggers[0] = NormalizeTrigger(config->triggerDeadzonePercent[0], m_buttonData.trigger_left);
+    normalData.triggers[1] = NormalizeTrigger(config->triggerDeadzonePercent[1], m_buttonData.trigger_right);
 
-    NormalizeAxis(m_buttonData.stick_left_x, m_buttonData.stick_left_y, _xbox360WControllerConfig.stickDeadzonePercent[0],
+    NormalizeAxis(m_buttonData.stick_left_x, m_buttonData.stick_left_y, config->stickDeadzonePercent[0],
                   &normalData.sticks[0].axis_x, &normalData.sticks[0].axis_y);
-    NormalizeAxis(m_buttonData.stick_right_x, m_buttonData.stick_right_y, _xbox360WControllerConfig.stickDeadzonePercent[1],
+    NormalizeAxis(m_buttonData.stick_right_x, m_buttonData.stick_right_y, config->stickDeadzonePercent[1],
                   &normalData.sticks[1].axis_x, &normalData.sticks[1].axis_y);
 
     bool buttons[MAX_CONTROLLER_BUTTONS]{
@@ -211,7 +228,7 @@ NormalizedButtonData Xbox360WirelessController::GetNormalizedButtonData()
 
     for (int i = 0; i != MAX_CONTROLLER_BUTTONS; ++i)
     {
-        ControllerButton button = _xbox360WControllerConfig.buttons[i];
+        ControllerButton button = config->buttons[i];
         if (button == NONE)
             continue;
 
@@ -235,12 +252,7 @@ ams::Result Xbox360WirelessController::SetLED(Xbox360LEDValue value)
 
 void Xbox360WirelessController::LoadConfig(const ControllerConfig *config)
 {
-    _xbox360WControllerConfig = *config;
-}
-
-ControllerConfig *Xbox360WirelessController::GetConfig()
-{
-    return &_xbox360WControllerConfig;
+    _xbox360WControllerConfig.Set(*config);
 }
 
 ams::Result Xbox360WirelessController::OnControllerConnect()
@@ -267,9 +279,9 @@ ams::Result Xbox360WirelessController::OutputBuffer()
     if (m_outputBuffer.empty())
         R_RETURN(1);
 
-    auto it = m_outputBuffer.begin();
-    R_TRY(WriteToEndpoint(it->packet, it->length));
-    m_outputBuffer.erase(it);
+    // Packets are queued together on a (re)connect, send them back to back instead of one per output tick
+    for (auto it = m_outputBuffer.begin(); it != m_outputBuffer.end(); it = m_outputBuffer.erase(it))
+        R_TRY(WriteToEndpoint(it->packet, it->length));
 
     R_SUCCEED();
 }
@@ -30,6 +30,7 @@ public:
 
     virtual ams::Result Initialize() override;
     virtual void Exit() override;
+    virtual ams::Result Resume() override;
 
     ams::Result OpenInterfaces();
     void CloseInterfaces();
@@ -52,7 +53,6 @@ public:
     ams::Result OnControllerDisconnect();
 
     static void LoadConfig(const ControllerConfig *config);
-    virtual ControllerConfig *GetConfig() override;
 
     ams::Result WriteToEndpoint(const uint8_t *buffer, size_t size);
 
@@ -1,10 +1,12 @@
 #include "Controllers/XboxController.h"
 #include <cmath>
+#include <cstring>
+#include <algorithm>
 
-static ControllerConfig _xboxControllerConfig{};
+static SharedControllerConfig _xboxControllerConfig;
 
 XboxController::XboxController(std::unique_ptr<IUSBDevice> &&interface)
-    : IController(std::move(interface))
+    : IController(std::move(interface), &_xboxControllerConfig)
 {
 }
 
@@ -84,11 +86,17 @@ void XboxController::CloseInterfaces()
 
 ams::Result XboxController::GetInput()
 {
-    uint8_t input_bytes[64];
+    uint8_t input_bytes[64]{};
+    size_t size;
 
-    R_TRY(m_inPipe->Read(input_bytes, sizeof(input_bytes)));
+    R_TRY(m_inPipe->Read(input_bytes, sizeof(input_bytes), &size));
 
-    m_buttonData = *reinterpret_cast<XboxButtonData *>(input_bytes);
+    static_assert(sizeof(XboxButtonData) <= sizeof(input_bytes));
+    // A short report is dropped instead of being padded out, the triggers and buttons would read as released
+    if (size >= sizeof(m_buttonData))
+    {
+        std::memcpy(&m_buttonData, input_bytes, sizeof(m_buttonData));
+    }
 
     R_SUCCEED();
 }
@@ -140,14 +148,15 @@ void XboxController::NormalizeAxis(int16_t x,
 // Pass by value should hopefully be optimized away by RVO
 NormalizedButtonData XboxController::GetNormalizedButtonData()
 {
+    const ControllerConfigRef config = GetConfig();
     NormalizedButtonData normalData{};
 
-    normalData.triggers[0] = NormalizeTrigger(_xboxControllerConfig.triggerDeadzonePercent[0], m_buttonData.trigger_left);
-    normalData.triggers[1] = NormalizeTrigger(_xboxControllerConfig.triggerDeadzonePercent[1], m_buttonData.trigger_right);
+    normalData.triggers[0] = NormalizeTrigger(config->triggerDeadzonePercent[0], m_buttonData.trigger_left);
+    normalData.triggers[1] = NormalizeTrigger(config->triggerDeadzonePercent[1], m_buttonData.trigger_right);
 
-    NormalizeAxis(m_buttonData.stick_left_x, m_buttonData.stick_left_y, _xboxControllerConfig.stickDeadzonePercent[0],
+    NormalizeAxis(m_buttonData.stick_left_x, m_buttonData.stick_left_y, config->stickDeadzonePercent[0],
                   &normalData.sticks[0].axis_x, &normalData.sticks[0].axis_y);
-    NormalizeAxis(m_buttonData.stick_right_x, m_buttonData.stick_right_y, _xboxControllerConfig.stickDeadzonePercent[1],
+    NormalizeAxis(m_buttonData.stick_right_x, m_buttonData.stick_right_y, config->stickDeadzonePercent[1],
                   &normalData.sticks[1].axis_x, &normalData.sticks[1].axis_y);
 
     bool buttons[MAX_CONTROLLER_BUTTONS]{
@@ -173,7 +182,7 @@ NormalizedButtonData XboxController::GetNormalizedButtonData()
 
     for (int i = 0; i != MAX_CONTROLLER_BUTTONS; ++i)
     {
-        ControllerButton button = _xboxControllerConfig.buttons[i];
+        ControllerButton button = config->buttons[i];
         if (button == NONE)
             continue;
 
@@ -191,10 +200,5 @@ ams::Result XboxController::SetRumble(uint8_t strong_magnitude, uint8_t weak_mag
 
 void XboxController::LoadConfig(const ControllerConfig *config)
 {
-    _xboxControllerConfig = *config;
-}
-
-ControllerConfig *XboxController::GetConfig()
-{
-    return &_xboxControllerConfig;
+    _xboxControllerConfig.Set(*config);
 }
\ No newline at end of file
@@ -72,7 +72,7 @@ public:
 
     virtual NormalizedButtonData GetNormalizedButtonData() override;
 
-    virtual ControllerType GetType() override { return CONTROLLER_XBOX360; }
+    virtual ControllerType GetType() override { return CONTROLLER_XBOXORIG; }
 
     inline const XboxButtonData &GetButtonData() { return m_buttonData; };
 
@@ -82,5 +82,4 @@ public:
     ams::Result SetRumble(uint8_t strong_magnitude, uint8_t weak_magnitude);
 
     static void LoadConfig(const ControllerConfig *config);
-    virtual ControllerConfig *GetConfig() override;
 };
\ No newline at end of file
@@ -1,8 +1,12 @@
 #include "Controllers/XboxOneController.h"
+#include "ControllerDatabase.h"
+#include "InitStepCache.h"
 #include <cmath>
+#include <cstring>
+#include <algorithm>
 // #include "../../Sysmodule/source/log.h"
 
-static ControllerConfig _xboxoneControllerConfig{};
+static SharedControllerConfig _xboxoneControllerConfig;
 
 #define TRIGGER_MAXVALUE 1023
 
@@ -40,29 +44,31 @@ static constexpr uint8_t xboxone_rumbleend_init[] = {
     0x09, 0x00, 0x00, 0x09, 0x00, 0x0F, 0x00, 0x00,
     0x00, 0x00, 0x00, 0x00, 0x00};
 
-struct VendorProductPacket
+struct QuirkPacket
 {
-    uint16_t VendorID;
-    uint16_t ProductID;
+    uint8_t Quirk; // DEVICE_QUIRK_NONE is sent to every controller
     const uint8_t *Packet;
     uint8_t Length;
+    bool Required; // A controller that keeps rejecting an optional packet doesn't need it, see InitStepCache.h
 };
 
-static constexpr VendorProductPacket init_packets[]{
-    {0x0e6f, 0x0165, xboxone_hori_init, sizeof(xboxone_hori_init)},
-    {0x0f0d, 0x0067, xboxone_hori_init, sizeof(xboxone_hori_init)},
+// Sent in order, which controller gets which packets is decided by the device database
+static constexpr QuirkPacket init_packets[]{
+    {DEVICE_QUIRK_XBONE_HORI_INIT, xboxone_hori_init, sizeof(xboxone_hori_init), false},
 
-    {0x0000, 0x0000, xboxone_test_init1, sizeof(xboxone_test_init1)},
+    {DEVICE_QUIRK_NONE, xboxone_test_init1, sizeof(xboxone_test_init1), false},
 
-    {0x0000, 0x0000, xboxone_fw2015_init, sizeof(xboxone_fw2015_init)},
-    {0x0e6f, 0x0000, xboxone_pdp_init1, sizeof(xboxone_pdp_init1)},
-    {0x0e6f, 0x0000, xboxone_pdp_init2, sizeof(xboxone_pdp_init2)},
-    {0x24c6, 0x0000, xboxone_rumblebegin_init, sizeof(xboxone_rumblebegin_init)},
-    {0x24c6, 0x0000, xboxone_rumbleend_init, sizeof(xboxone_rumbleend_init)},
+    {DEVICE_QUIRK_NONE, xboxone_fw2015_init, sizeof(xboxone_fw2015_init), true},
+    {DEVICE_QUIRK_XBONE_PDP_INIT, xboxone_pdp_init1, sizeof(xboxone_pdp_init1), false},
+    {DEVICE_QUIRK_XBONE_PDP_INIT, xboxone_pdp_init2, sizeof(xboxone_pdp_init2), false},
+    {DEVICE_QUIRK_XBONE_RUMBLE_INIT, xboxone_rumblebegin_init, sizeof(xboxone_rumblebegin_init), false},
+    {DEVICE_QUIRK_XBONE_RUMBLE_INIT, xboxone_rumbleend_init, sizeof(xboxone_rumbleend_init), false},
 };
 
+static_assert(sizeof(init_packets) / sizeof(QuirkPacket) <= MaxInitSteps);
+
 XboxOneController::XboxOneController(std::unique_ptr<IUSBDevice> &&interface)
-    : IController(std::move(interface))
+    : IController(std::move(interface), &_xboxoneControllerConfig)
 {
 }
 
@@ -74,7 +80,8 @@ XboxOneController::~XboxOneController()
 ams::Result XboxOneController::Initialize()
 {
     R_TRY(OpenInterfaces());
-    R_TRY(SendInitBytes());
+    m_completedInitSteps = 0;
+    R_TRY(SendInitBytes(false));
 
     R_SUCCEED();
 }
@@ -84,6 +91,11 @@ void XboxOneController::Exit()
     CloseInterfaces();
 }
 
+ams::Result XboxOneController::Resume()
+{
+    R_RETURN(SendInitBytes(true));
+}
+
 ams::Result XboxOneController::OpenInterfaces()
 {
     R_TRY(m_device->Open());
@@ -144,15 +156,19 @@ void XboxOneController::CloseInterfaces()
 
 ams::Result XboxOneController::GetInput()
 {
-    uint8_t input_bytes[64];
+    // Zeroed so that the header checks below never look at stale bytes of a short report
+    uint8_t input_bytes[64]{};
+    size_t size;
 
-    R_TRY(m_inPipe->Read(input_bytes, sizeof(input_bytes)));
+    R_TRY(m_inPipe->Read(input_bytes, sizeof(input_bytes), &size));
 
-    uint8_t type = input_bytes[0];
+    uint8_t type = size != 0 ? input_bytes[0] : 0;
 
+    static_assert(sizeof(XboxOneButtonData) <= sizeof(input_bytes));
+    // input_bytes is zeroed past the end of the report, so a short one never leaves fields of the previous one behind
     if (type == XBONEINPUT_BUTTON) // Button data
     {
-        m_buttonData = *reinterpret_cast<XboxOneButtonData *>(input_bytes);
+        std::memcpy(&m_buttonData, input_bytes, sizeof(m_buttonData));
     }
     else if (type == XBONEINPUT_GUIDEBUTTON) // Guide button Result
     {
@@ -169,18 +185,35 @@ ams::Result XboxOneController::GetInput()
     R_SUCCEED();
 }
 
-ams::Result XboxOneController::SendInitBytes()
+ams::Result XboxOneController::SendInitBytes(bool resuming)
 {
-    uint16_t vendor = m_device->GetVendor();
-    uint16_t product = m_device->GetProduct();
-    for (int i = 0; i != (sizeof(init_packets) / sizeof(VendorProductPacket)); ++i)
+    uint8_t quirks = GetDeviceQuirks(m_device->GetVendor(), m_device->GetProduct());
+    uint32_t rejected = BeginInitSteps(m_device.get());
+    for (size_t i = 0; i != sizeof(init_packets) / sizeof(QuirkPacket); ++i)
     {
-        if (init_packets[i].VendorID != 0 && init_packets[i].VendorID != vendor)
+        const QuirkPacket &packet = init_packets[i];
+        if (packet.Quirk != DEVICE_QUIRK_NONE && (packet.Quirk & quirks) == 0)
+            continue;
+
+        if (packet.Required)
+        {
+            R_TRY(m_outPipe->Write(packet.Packet, packet.Length));
             continue;
-        if (init_packets[i].ProductID != 0 && init_packets[i].ProductID != product)
+        }
+
+        // A reconnected controller was power cycled by the unplug, only one that was asleep still has the steps that went through
+        uint32_t step = 1u << i;
+        if ((rejected & step) || (resuming && (m_completedInitSteps & step)))
             continue;
 
-        R_TRY(m_outPipe->Write(init_packets[i].Packet, init_packets[i].Length));
+        ams::Result rc = m_outPipe->Write(packet.Packet, packet.Length);
+        if (R_SUCCEEDED(rc))
+            m_completedInitSteps |= step;
+
+        // Until the step counts as rejected, failing it fails the init like any other step
+        if (RecordInitStep(m_device.get(), i, R_SUCCEEDED(rc)))
+            continue;
+        R_TRY(rc);
     }
 
     R_SUCCEED();
@@ -233,14 +266,15 @@ void XboxOneController::NormalizeAxis(int16_t x,
 // Pass by value should hopefully be optimized away by RVO
 NormalizedButtonData XboxOneController::GetNormalizedButtonData()
 {
+    const ControllerConfigRef config = GetConfig();
     NormalizedButtonData normalData{};
 
-    normalData.triggers[0] = NormalizeTrigger(_xboxoneControllerConfig.triggerDeadzonePercent[0], m_buttonData.trigger_left);
-    normalData.triggers[1] = NormalizeTrigger(_xboxoneControllerConfig.triggerDeadzonePercent[1], m_buttonData.trigger_right);
+    normalData.triggers[0] = NormalizeTrigger(config->triggerDeadzonePercent[0], m_buttonData.trigger_left);
+    normalData.triggers[1] = NormalizeTrigger(config->triggerDeadzonePercent[1], m_buttonData.trigger_right);
 
-    NormalizeAxis(m_buttonData.stick_left_x, m_buttonData.stick_left_y, _xboxoneControllerConfig.stickDeadzonePercent[0],
+    NormalizeAxis(m_buttonData.stick_left_x, m_buttonData.stick_left_y, config->stickDeadzonePercent[0],
                   &normalData.sticks[0].axis_x, &normalData.sticks[0].axis_y);
-    NormalizeAxis(m_buttonData.stick_right_x, m_buttonData.stick_right_y, _xboxoneControllerConfig.stickDeadzonePercent[1],
+    NormalizeAxis(m_buttonData.stick_right_x, m_buttonData.stick_right_y, config->stickDeadzonePercent[1],
                   &normalData.sticks[1].axis_x, &normalData.sticks[1].axis_y);
 
     bool buttons[MAX_CONTROLLER_BUTTONS]{
@@ -266,7 +300,7 @@ NormalizedButtonData XboxOneController::GetNormalizedButtonData()
 
     for (int i = 0; i != MAX_CONTROLLER_BUTTONS; ++i)
     {
-        ControllerButton button = _xboxoneControllerConfig.buttons[i];
+        ControllerButton button = config->buttons[i];
         if (button == NONE)
             continue;
 
@@ -298,10 +332,5 @@ ams::Result XboxOneController::SetRumble(uint8_t strong_magnitude, uint8_t weak_
 
 void XboxOneController::LoadConfig(const ControllerConfig *config)
 {
-    _xboxoneControllerConfig = *config;
-}
-
-ControllerConfig *XboxOneController::GetConfig()
-{
-    return &_xboxoneControllerConfig;
+    _xboxoneControllerConfig.Set(*config);
 }
\ No newline at end of file
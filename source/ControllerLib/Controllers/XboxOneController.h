@@ -80,6 +80,8 @@ private:
 
     XboxOneButtonData m_buttonData{};
     bool m_GuidePressed{false};
+    // Optional init steps that went through since the controller was connected, the device keeps them across sleep
+    uint32_t m_completedInitSteps{0};
 
 public:
     XboxOneController(std::unique_ptr<IUSBDevice> &&interface);
@@ -87,6 +89,7 @@ public:
 
     virtual ams::Result Initialize() override;
     virtual void Exit() override;
+    virtual ams::Result Resume() override;
 
     ams::Result OpenInterfaces();
     void CloseInterfaces();
@@ -102,10 +105,9 @@ public:
     float NormalizeTrigger(uint8_t deadzonePercent, uint16_t value);
     void NormalizeAxis(int16_t x, int16_t y, uint8_t deadzonePercent, float *x_out, float *y_out);
 
-    ams::Result SendInitBytes();
+    ams::Result SendInitBytes(bool resuming);
     ams::Result WriteAckGuideReport(uint8_t sequence);
     ams::Result SetRumble(uint8_t strong_magnitude, uint8_t weak_magnitude);
 
     static void LoadConfig(const ControllerConfig *config);
-    virtual ControllerConfig *GetConfig() override;
 };
\ No newline at end of file
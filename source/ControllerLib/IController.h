@@ -14,9 +14,14 @@ class IController
 {
 protected:
     std::unique_ptr<IUSBDevice> m_device;
+    // Points to the driver's shared config unless the device has a profile of its own
+    const SharedControllerConfig *m_config;
+
+    static inline const ControllerConfig s_defaultConfig{};
 
 public:
-    IController(std::unique_ptr<IUSBDevice> &&interface) : m_device(std::move(interface))
+    IController(std::unique_ptr<IUSBDevice> &&interface, const SharedControllerConfig *config = nullptr)
+        : m_device(std::move(interface)), m_config(config)
     {
     }
     virtual ~IController() = default;
@@ -26,6 +31,9 @@ public:
     // Since Exit is used to clean up resources, no Result report should be needed
     virtual void Exit() = 0;
 
+    // Called after the console wakes up, with the interfaces still open. Re-sends what the device may have lost while suspended
+    virtual ams::Result Resume() { R_SUCCEED(); }
+
     virtual ams::Result GetInput() { R_RETURN(1); }
 
     virtual NormalizedButtonData GetNormalizedButtonData() { return NormalizedButtonData(); }
@@ -37,5 +45,9 @@ public:
 
     virtual ams::Result OutputBuffer() { R_RETURN(1); };
 
-    virtual ControllerConfig *GetConfig() { return nullptr; }
+    // Take it once per frame and let go of it before the next one, it may be swapped for another one between frames
+    inline ControllerConfigRef GetConfig() { return m_config ? m_config->Get() : ControllerConfigRef(&s_defaultConfig, nullptr); }
+    inline const SharedControllerConfig *GetSharedConfig() { return m_config; }
+    // Must be called before the controller is handed to its handler, the config has to outlive the controller
+    inline void SetSharedConfig(const SharedControllerConfig *config) { m_config = config; }
 };
\ No newline at end of file
@@ -9,6 +9,8 @@ protected:
 
     uint16_t m_vendorID;
     uint16_t m_productID;
+    // Identifies the port the device is plugged into, it stays the same when the device is reconnected there
+    uint32_t m_portID{};
 
 public:
     virtual ~IUSBDevice() = default;
@@ -25,4 +27,5 @@ public:
 
     virtual uint16_t GetVendor() { return m_vendorID; }
     virtual uint16_t GetProduct() { return m_productID; }
+    virtual uint32_t GetPortID() { return m_portID; }
 };
\ No newline at end of file
@@ -31,7 +31,8 @@ public:
     virtual ams::Result Write(const void *inBuffer, size_t bufferSize) = 0;
 
     // This will read from the endpoint and put the data in the outBuffer pointer for the specified size.
-    virtual ams::Result Read(void *outBuffer, size_t bufferSize) = 0;
+    // transferredSize is set to how much was actually read, a device is free to send less than was asked for
+    virtual ams::Result Read(void *outBuffer, size_t bufferSize, size_t *transferredSize) = 0;
 
     // Get endpoint's direction. (IN or OUT)
     virtual IUSBEndpoint::Direction GetDirection() = 0;
@@ -0,0 +1,86 @@
+#include "InitStepCache.h"
+#include <array>
+
+namespace
+{
+    struct InitStepEntry
+    {
+        uint16_t vendor_id;
+        uint16_t product_id;
+        uint32_t port_id;
+        // Connects in a row each step failed on
+        std::array<uint8_t, MaxInitSteps> failures;
+        uint8_t connectsSinceRetry;
+        bool used;
+    };
+
+    constexpr size_t MaxInitStepEntries = 16;
+
+    std::array<InitStepEntry, MaxInitStepEntries> entries{};
+    size_t nextEntry = 0;
+    ams::os::Mutex entriesMutex(false);
+
+    // Must be called with entriesMutex held
+    InitStepEntry *FindEntry(IUSBDevice *device)
+    {
+        for (InitStepEntry &entry : entries)
+        {
+            if (entry.used && entry.vendor_id == device->GetVendor() && entry.product_id == device->GetProduct() && entry.port_id == device->GetPortID())
+                return &entry;
+        }
+        return nullptr;
+    }
+} // namespace
+
+uint32_t BeginInitSteps(IUSBDevice *device)
+{
+    std::scoped_lock lock(entriesMutex);
+    InitStepEntry *entry = FindEntry(device);
+    if (entry == nullptr)
+        return 0;
+
+    uint32_t rejected = 0;
+    for (size_t i = 0; i != MaxInitSteps; ++i)
+    {
+        if (entry->failures[i] >= MaxInitStepFailures)
+            rejected |= 1u << i;
+    }
+
+    if (rejected != 0 && ++entry->connectsSinceRetry >= RejectedStepRetryConnects)
+    {
+        entry->connectsSinceRetry = 0;
+        return 0;
+    }
+
+    return rejected;
+}
+
+bool RecordInitStep(IUSBDevice *device, uint32_t step, bool succeeded)
+{
+    if (step >= MaxInitSteps)
+        return false;
+
+    std::scoped_lock lock(entriesMutex);
+    InitStepEntry *entry = FindEntry(device);
+    if (entry == nullptr)
+    {
+        // Nothing to remember about a device that took the step
+        if (succeeded)
+            return false;
+
+        // Once full, the oldest device is forgotten
+        entry = &entries[nextEntry];
+        nextEntry = (nextEntry + 1) % entries.size();
+        *entry = {device->GetVendor(), device->GetProduct(), device->GetPortID(), {}, 0, true};
+    }
+
+    if (succeeded)
+    {
+        entry->failures[step] = 0;
+        return false;
+    }
+
+    if (entry->failures[step] < MaxInitStepFailures)
+        ++entry->failures[step];
+    return entry->failures[step] >= MaxInitStepFailures;
+}
\ No newline at end of file
@@ -0,0 +1,17 @@
+#pragma once
+#include "IUSBDevice.h"
+
+// Remembers which optional init steps a device rejected on its last connects, so that when the same device comes back
+// on the same port (after sleep or a cable reseat) it isn't put through them again.
+// Each driver numbers its own steps. A step only counts as rejected once it failed MaxInitStepFailures connects in a row,
+// a single failed transfer could just as well be the device not being ready yet. Rejected steps are tried again every
+// RejectedStepRetryConnects connects, and a step that goes through is forgotten about.
+
+constexpr size_t MaxInitSteps = 16;
+constexpr uint8_t MaxInitStepFailures = 3;
+constexpr uint8_t RejectedStepRetryConnects = 8;
+
+// Get the steps to skip on this connect, call it once per connect
+uint32_t BeginInitSteps(IUSBDevice *device);
+// Record how a step went. Returns true if the step counts as rejected
+bool RecordInitStep(IUSBDevice *device, uint32_t step, bool succeeded);
\ No newline at end of file
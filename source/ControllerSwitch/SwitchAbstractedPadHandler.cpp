@@ -1,10 +1,10 @@
 #include "SwitchAbstractedPadHandler.h"
 #include "ControllerHelpers.h"
 #include <cmath>
-#include <array>
 
-SwitchAbstractedPadHandler::SwitchAbstractedPadHandler(std::unique_ptr<IController> &&controller)
-    : SwitchVirtualGamepadHandler(std::move(controller))
+SwitchAbstractedPadHandler::SwitchAbstractedPadHandler(std::unique_ptr<IController> &&controller, GamepadHandlerStacks *stacks, s8 padSlot)
+    : SwitchVirtualGamepadHandler(std::move(controller), stacks),
+      m_abstractedPadID(padSlot)
 {
 }
 
@@ -46,37 +46,14 @@ void SwitchAbstractedPadHandler::Exit()
     ExitAbstractedPadState();
 }
 
-// Used to give out unique ids to abstracted pads
-static std::array<bool, 8> uniqueIDs{};
-
-static s8 getUniqueId()
-{
-    for (s8 i = 0; i != 8; ++i)
-    {
-        if (uniqueIDs[i] == false)
-        {
-            uniqueIDs[i] = true;
-            return i;
-        }
-    }
-
-    return 0;
-}
-
-static void freeUniqueId(s8 id)
-{
-    uniqueIDs[id] = false;
-}
-
 ams::Result SwitchAbstractedPadHandler::InitAbstractedPadState()
 {
     m_state = {0};
-    m_abstractedPadID = getUniqueId();
     m_state.type = BIT(0);
     m_state.npadInterfaceType = HidNpadInterfaceType_USB;
     m_state.flags = 0xff;
     m_state.state.battery_level = 4;
-    ControllerConfig *config = GetController()->GetConfig();
+    const ControllerConfigRef config = GetController()->GetConfig();
     m_state.singleColorBody = config->bodyColor.rgbaValue;
     m_state.singleColorButtons = config->buttonsColor.rgbaValue;
 
@@ -85,7 +62,6 @@ ams::Result SwitchAbstractedPadHandler::InitAbstractedPadState()
 
 ams::Result SwitchAbstractedPadHandler::ExitAbstractedPadState()
 {
-    freeUniqueId(m_abstractedPadID);
     R_RETURN(hiddbgUnsetAutoPilotVirtualPadState(m_abstractedPadID));
 }
 
@@ -117,9 +93,9 @@ void SwitchAbstractedPadHandler::FillAbstractedState(const NormalizedButtonData
     if (data.buttons[11])
         m_state.state.buttons |= HidNpadButton_Plus;
 
-    ControllerConfig *config = GetController()->GetConfig();
+    const ControllerConfigRef config = GetController()->GetConfig();
 
-    if (config && config->swapDPADandLSTICK)
+    if (config->swapDPADandLSTICK)
     {
         if (data.sticks[0].axis_y > 0.5f)
             m_state.state.buttons |= HidNpadButton_Up;
@@ -166,14 +142,14 @@ ams::Result SwitchAbstractedPadHandler::UpdateAbstractedState()
     R_RETURN(hiddbgSetAutoPilotVirtualPadState(m_abstractedPadID, &m_state));
 }
 
-void SwitchAbstractedPadHandler::UpdateInput()
+ams::Result SwitchAbstractedPadHandler::UpdateInput()
 {
-    if (R_FAILED(GetController()->GetInput()))
-        return;
+    R_TRY(GetController()->GetInput());
 
     FillAbstractedState(GetController()->GetNormalizedButtonData());
-    if (R_FAILED(UpdateAbstractedState()))
-        return;
+    UpdateAbstractedState();
+
+    R_SUCCEED();
 }
 
 void SwitchAbstractedPadHandler::UpdateOutput()
@@ -190,5 +166,5 @@ void SwitchAbstractedPadHandler::UpdateOutput()
     //         GetController()->SetRumble(static_cast<uint8_t>(value.amp_high * 255.0f), static_cast<uint8_t>(value.amp_low * 255.0f));
     // }
 
-    svcSleepThread(1e+7L);
+    m_outputThread.Sleep(1e+7L);
 }
\ No newline at end of file
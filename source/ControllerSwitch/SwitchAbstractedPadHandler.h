@@ -12,8 +12,11 @@ private:
     HiddbgAbstractedPadState m_state;
 
 public:
-    // Initialize the class with specified controller
-    SwitchAbstractedPadHandler(std::unique_ptr<IController> &&controller);
+    // HID only has this many abstracted pad ids
+    static constexpr u32 MaxAbstractedPads = 8;
+
+    // Initialize the class with specified controller, the pad slot it was given is used as its abstracted pad id
+    SwitchAbstractedPadHandler(std::unique_ptr<IController> &&controller, GamepadHandlerStacks *stacks, s8 padSlot);
     ~SwitchAbstractedPadHandler();
 
     // Initialize controller handler, AbstractedPadState
@@ -21,7 +24,7 @@ public:
     virtual void Exit() override;
 
     // This will be called periodically by the input threads
-    virtual void UpdateInput() override;
+    virtual ams::Result UpdateInput() override;
     // This will be called periodically by the output threads
     virtual void UpdateOutput() override;
 
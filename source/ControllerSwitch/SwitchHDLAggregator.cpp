@@ -0,0 +1,196 @@
+#include "SwitchHDLAggregator.h"
+#include "SwitchHDLHandler.h"
+#include "SwitchWorkerThread.h"
+#include "SwitchTrace.h"
+#include <atomic>
+
+namespace
+{
+    struct DeviceSlot
+    {
+        bool used;
+        bool attached;
+        bool dirty;
+        HiddbgHdlsHandle handle;
+        HiddbgHdlsState state;
+    };
+
+    struct PendingState
+    {
+        s32 slot;
+        HiddbgHdlsHandle handle;
+        HiddbgHdlsState state;
+    };
+
+    // Result returned by hid when the handle no longer refers to an attached device
+    constexpr u32 ResultHdlsDeviceNotAttached = 0x1c24ca;
+
+    DeviceSlot g_slots[SwitchHDLAggregator::MaxDevices];
+    ams::os::Mutex g_slotMutex(false);
+
+    std::atomic<u64> g_submitIntervalNs{SwitchHDLAggregator::DefaultSubmitIntervalNs};
+
+    // Only ever touched by the submit thread, kept out of its stack
+    PendingState g_pending[SwitchHDLAggregator::MaxDevices];
+    HiddbgHdlsStateList g_stateList;
+
+    alignas(ams::os::ThreadStackAlignment) u8 submit_thread_stack[0x1000];
+    SwitchWorkerThread g_submit_thread;
+    // When the last tick was due. Only touched by the submit thread once it's running
+    u64 g_nextSubmitTick;
+
+    void MarkDropped(const PendingState &pending)
+    {
+        SwitchTrace::Record(TraceEvent_HdlDropped, pending.slot);
+
+        std::scoped_lock lock(g_slotMutex);
+        DeviceSlot &slot = g_slots[pending.slot];
+
+        // The handler may have re-attached it in the meantime
+        if (slot.used && slot.handle.handle == pending.handle.handle)
+            slot.attached = false;
+    }
+
+    void SubmitSingleState(const PendingState &pending)
+    {
+        if (hiddbgSetHdlsState(pending.handle, &pending.state) == ResultHdlsDeviceNotAttached)
+            MarkDropped(pending);
+    }
+
+    void SubmitPendingStates(s32 count)
+    {
+        SwitchTrace::Record(TraceEvent_HdlSubmit, count);
+
+        // The state list takes two round trips, so it only pays off past two devices
+        if (count <= 2)
+        {
+            for (s32 i = 0; i != count; ++i)
+                SubmitSingleState(g_pending[i]);
+            return;
+        }
+
+        if (R_FAILED(hiddbgDumpHdlsStates(SwitchHDLHandler::GetHdlsSessionId(), &g_stateList)))
+            return;
+
+        for (s32 i = 0; i != count; ++i)
+        {
+            bool found = false;
+            for (s32 j = 0; j != g_stateList.total_entries; ++j)
+            {
+                if (g_stateList.entries[j].handle.handle == g_pending[i].handle.handle)
+                {
+                    g_stateList.entries[j].state = g_pending[i].state;
+                    found = true;
+                    break;
+                }
+            }
+
+            if (!found)
+                MarkDropped(g_pending[i]);
+        }
+
+        // A device was dropped after the dump. The list doesn't say which one, so the states go out one by one,
+        // which finds it without making the handlers of the others attach their device a second time
+        if (hiddbgApplyHdlsStateList(SwitchHDLHandler::GetHdlsSessionId(), &g_stateList) == ResultHdlsDeviceNotAttached)
+        {
+            for (s32 i = 0; i != count; ++i)
+                SubmitSingleState(g_pending[i]);
+        }
+    }
+
+    void SubmitThreadFunc(void *)
+    {
+        // Every tick is due one interval after the previous one was, not after the last submit finished, so the time
+        // spent submitting doesn't add up. A tick that was missed entirely (e.g. while asleep) isn't made up for
+        u64 intervalTicks = armNsToTicks(g_submitIntervalNs.load(std::memory_order_relaxed));
+        g_nextSubmitTick += intervalTicks;
+
+        u64 now = armGetSystemTick();
+        if (now >= g_nextSubmitTick + intervalTicks)
+            g_nextSubmitTick = now;
+        else if (g_nextSubmitTick > now && !g_submit_thread.Sleep(armTicksToNs(g_nextSubmitTick - now)))
+            return;
+
+        s32 count = 0;
+        {
+            std::scoped_lock lock(g_slotMutex);
+            for (s32 i = 0; i != SwitchHDLAggregator::MaxDevices; ++i)
+            {
+                DeviceSlot &slot = g_slots[i];
+                if (!slot.used || !slot.attached || !slot.dirty)
+                    continue;
+
+                g_pending[count++] = {i, slot.handle, slot.state};
+                slot.dirty = false;
+            }
+        }
+
+        if (count != 0)
+            SubmitPendingStates(count);
+    }
+} // namespace
+
+ams::Result SwitchHDLAggregator::Initialize()
+{
+    g_nextSubmitTick = armGetSystemTick();
+    R_RETURN(g_submit_thread.Start(&SubmitThreadFunc, nullptr, submit_thread_stack, sizeof(submit_thread_stack), 0x30));
+}
+
+void SwitchHDLAggregator::Exit()
+{
+    g_submit_thread.Join();
+}
+
+void SwitchHDLAggregator::SetSubmitInterval(u64 intervalNs)
+{
+    g_submitIntervalNs.store(intervalNs != 0 ? intervalNs : DefaultSubmitIntervalNs, std::memory_order_relaxed);
+}
+
+s32 SwitchHDLAggregator::Register()
+{
+    std::scoped_lock lock(g_slotMutex);
+    for (s32 i = 0; i != MaxDevices; ++i)
+    {
+        if (!g_slots[i].used)
+        {
+            g_slots[i] = {};
+            g_slots[i].used = true;
+            return i;
+        }
+    }
+
+    return InvalidSlot;
+}
+
+void SwitchHDLAggregator::Unregister(s32 slot)
+{
+    std::scoped_lock lock(g_slotMutex);
+    g_slots[slot] = {};
+}
+
+void SwitchHDLAggregator::SetAttached(s32 slot, HiddbgHdlsHandle handle)
+{
+    std::scoped_lock lock(g_slotMutex);
+    g_slots[slot].handle = handle;
+    g_slots[slot].attached = true;
+}
+
+void SwitchHDLAggregator::SetDetached(s32 slot)
+{
+    std::scoped_lock lock(g_slotMutex);
+    g_slots[slot].attached = false;
+    g_slots[slot].dirty = false;
+}
+
+bool SwitchHDLAggregator::IsAttached(s32 slot)
+{
+    std::scoped_lock lock(g_slotMutex);
+    return g_slots[slot].attached;
+}
+
+void SwitchHDLAggregator::Submit(s32 slot, const HiddbgHdlsState &state)
+{
+    std::scoped_lock lock(g_slotMutex);
+    g_slots[slot].state = state;
+    g_slots[slot].dirty = true;
+}
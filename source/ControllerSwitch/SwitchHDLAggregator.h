@@ -0,0 +1,33 @@
+#pragma once
+#include <switch.h>
+#include <stratosphere.hpp>
+
+// Collects the latest HDL state of every attached virtual device and hands them to HID together once per tick,
+// instead of every handler doing its own hiddbgSetHdlsState call for every report it reads. [7.0.0+]
+class SwitchHDLAggregator
+{
+public:
+    static constexpr s32 MaxDevices = 0x10;
+    static constexpr s32 InvalidSlot = -1;
+
+    // HID updates the npad states every 5ms, there's no point in submitting any faster than that
+    static constexpr u64 DefaultSubmitIntervalNs = 5'000'000;
+
+    static ams::Result Initialize();
+    static void Exit();
+
+    static void SetSubmitInterval(u64 intervalNs);
+
+    // Reserve a slot for a virtual device. Returns InvalidSlot if all slots are taken
+    static s32 Register();
+    static void Unregister(s32 slot);
+
+    // Tell the aggregator which HDL handle the slot's device was attached as, or that it was detached
+    static void SetAttached(s32 slot, HiddbgHdlsHandle handle);
+    static void SetDetached(s32 slot);
+    // Returns false if the device was never attached, or HID dropped it and it has to be attached again
+    static bool IsAttached(s32 slot);
+
+    // Store the state to be sent on the next tick, replacing any state that hasn't been sent yet
+    static void Submit(s32 slot, const HiddbgHdlsState &state);
+};
@@ -1,11 +1,12 @@
 #include "SwitchHDLHandler.h"
 #include "ControllerHelpers.h"
+#include "SwitchTrace.h"
 #include <cmath>
 
 static HiddbgHdlsSessionId g_hdlsSessionId;
 
-SwitchHDLHandler::SwitchHDLHandler(std::unique_ptr<IController> &&controller)
-    : SwitchVirtualGamepadHandler(std::move(controller))
+SwitchHDLHandler::SwitchHDLHandler(std::unique_ptr<IController> &&controller, GamepadHandlerStacks *stacks)
+    : SwitchVirtualGamepadHandler(std::move(controller), stacks)
 {
 }
 
@@ -58,7 +59,7 @@ ams::Result SwitchHDLHandler::InitHdlState()
     m_deviceInfo.deviceType = HidDeviceType_FullKey15;
     m_deviceInfo.npadInterfaceType = HidNpadInterfaceType_USB;
     // Set the controller colors. The grip colors are for Pro-Controller on [9.0.0+].
-    ControllerConfig *config = m_controller->GetConfig();
+    const ControllerConfigRef config = m_controller->GetConfig();
     m_deviceInfo.singleColorBody = config->bodyColor.rgbaValue;
     m_deviceInfo.singleColorButtons = config->buttonsColor.rgbaValue;
     m_deviceInfo.colorLeftGrip = config->leftGripColor.rgbaValue;
@@ -70,28 +71,57 @@ ams::Result SwitchHDLHandler::InitHdlState()
     m_hdlState.analog_stick_r.x = 0x5678;
     m_hdlState.analog_stick_r.y = -0x5678;
 
+    m_hdlSlot = SwitchHDLAggregator::Register();
+
     if (m_controller->IsControllerActive())
+    {
         R_TRY(hiddbgAttachHdlsVirtualDevice(&m_hdlHandle, &m_deviceInfo));
+        if (m_hdlSlot != SwitchHDLAggregator::InvalidSlot)
+            SwitchHDLAggregator::SetAttached(m_hdlSlot, m_hdlHandle);
+    }
 
     R_SUCCEED();
 }
 
 ams::Result SwitchHDLHandler::ExitHdlState()
 {
+    if (m_hdlSlot != SwitchHDLAggregator::InvalidSlot)
+    {
+        SwitchHDLAggregator::Unregister(m_hdlSlot);
+        m_hdlSlot = SwitchHDLAggregator::InvalidSlot;
+    }
+
     R_RETURN(hiddbgDetachHdlsVirtualDevice(m_hdlHandle));
 }
 
 // Sets the state of the class's HDL controller to the state stored in class's hdl.state
 ams::Result SwitchHDLHandler::UpdateHdlState()
 {
-    Result rc = hiddbgSetHdlsState(m_hdlHandle, &m_hdlState);
-    if (rc == 0x1c24ca)
+    // Without an aggregator slot, pass the state to HID right away
+    if (m_hdlSlot == SwitchHDLAggregator::InvalidSlot)
+    {
+        Result rc = hiddbgSetHdlsState(m_hdlHandle, &m_hdlState);
+        if (rc == 0x1c24ca)
+        {
+            // Re-attach virtual gamepad and set state
+            SwitchTrace::Record(TraceEvent_HdlReattach, m_hdlSlot);
+            R_TRY(hiddbgAttachHdlsVirtualDevice(&m_hdlHandle, &m_deviceInfo));
+            R_TRY(hiddbgSetHdlsState(m_hdlHandle, &m_hdlState));
+        }
+
+        R_SUCCEED();
+    }
+
+    // The aggregator finds out when HID drops the device, re-attach it before queuing the state
+    if (!SwitchHDLAggregator::IsAttached(m_hdlSlot))
     {
-        // Re-attach virtual gamepad and set state
+        SwitchTrace::Record(TraceEvent_HdlReattach, m_hdlSlot);
         R_TRY(hiddbgAttachHdlsVirtualDevice(&m_hdlHandle, &m_deviceInfo));
-        R_TRY(hiddbgSetHdlsState(m_hdlHandle, &m_hdlState));
+        SwitchHDLAggregator::SetAttached(m_hdlSlot, m_hdlHandle);
     }
 
+    SwitchHDLAggregator::Submit(m_hdlSlot, m_hdlState);
+
     R_SUCCEED();
 }
 
@@ -125,9 +155,9 @@ void SwitchHDLHandler::FillHdlState(const NormalizedButtonData &data)
     if (data.buttons[11])
         m_hdlState.buttons |= HidNpadButton_Plus;
 
-    ControllerConfig *config = m_controller->GetConfig();
+    const ControllerConfigRef config = m_controller->GetConfig();
 
-    if (config && config->swapDPADandLSTICK)
+    if (config->swapDPADandLSTICK)
     {
         if (data.sticks[0].axis_y > 0.5f)
             m_hdlState.buttons |= HidNpadButton_Up;
@@ -177,29 +207,50 @@ void SwitchHDLHandler::FillHdlState(const NormalizedButtonData &data)
         m_hdlState.buttons |= HiddbgNpadButton_Home;
 }
 
-void SwitchHDLHandler::UpdateInput()
+void SwitchHDLHandler::Suspend()
 {
-    // We process any input packets here. If it fails, return and try again
-    if (R_FAILED(m_controller->GetInput()))
-        return;
+    SwitchVirtualGamepadHandler::Suspend();
+
+    // Don't leave whatever was held down pressed while asleep
+    if (!DoesControllerSupport(m_controller->GetType(), SUPPORTS_NOTHING) && m_controller->IsControllerActive())
+    {
+        FillHdlState(NormalizedButtonData{});
+        UpdateHdlState();
+    }
+}
+
+ams::Result SwitchHDLHandler::UpdateInput()
+{
+    // We process any input packets here. If it fails, let the input thread decide when to try again
+    R_TRY(m_controller->GetInput());
 
     // This is a check for controllers that can prompt themselves to go inactive - e.g. wireless Xbox 360 controllers
     if (!m_controller->IsControllerActive())
     {
-        hiddbgDetachHdlsVirtualDevice(m_hdlHandle);
+        if (m_hdlSlot == SwitchHDLAggregator::InvalidSlot)
+        {
+            hiddbgDetachHdlsVirtualDevice(m_hdlHandle);
+        }
+        else if (SwitchHDLAggregator::IsAttached(m_hdlSlot))
+        {
+            SwitchHDLAggregator::SetDetached(m_hdlSlot);
+            hiddbgDetachHdlsVirtualDevice(m_hdlHandle);
+        }
     }
     else
     {
         // We get the button inputs from the input packet and update the state of our controller
+        // A failure to pass the state to HID is not the device's fault, so it isn't reported back
         FillHdlState(m_controller->GetNormalizedButtonData());
-        if (R_FAILED(UpdateHdlState()))
-            return;
+        UpdateHdlState();
     }
+
+    R_SUCCEED();
 }
 
 void SwitchHDLHandler::UpdateOutput()
 {
-    // Process a single output packet from a buffer
+    // Process the queued output packets
     if (R_SUCCEEDED(m_controller->OutputBuffer()))
         return;
 
@@ -213,7 +264,7 @@ void SwitchHDLHandler::UpdateOutput()
     //         m_controller->SetRumble(static_cast<uint8_t>(value.amp_high * 255.0f), static_cast<uint8_t>(value.amp_low * 255.0f));
     // }
 
-    svcSleepThread(1e+7L);
+    m_outputThread.Sleep(1e+7L);
 }
 
 HiddbgHdlsSessionId &SwitchHDLHandler::GetHdlsSessionId()
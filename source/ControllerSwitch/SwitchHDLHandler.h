@@ -3,6 +3,7 @@
 #include <switch.h>
 #include "IController.h"
 #include "SwitchVirtualGamepadHandler.h"
+#include "SwitchHDLAggregator.h"
 
 //Wrapper for HDL functions for switch versions [7.0.0+]
 class SwitchHDLHandler : public SwitchVirtualGamepadHandler
@@ -11,18 +12,21 @@ private:
     HiddbgHdlsHandle m_hdlHandle;
     HiddbgHdlsDeviceInfo m_deviceInfo;
     HiddbgHdlsState m_hdlState;
+    // Slot in the state aggregator, or InvalidSlot if the state is passed to HID directly
+    s32 m_hdlSlot = SwitchHDLAggregator::InvalidSlot;
 
 public:
     //Initialize the class with specified controller
-    SwitchHDLHandler(std::unique_ptr<IController> &&controller);
+    SwitchHDLHandler(std::unique_ptr<IController> &&controller, GamepadHandlerStacks *stacks);
     ~SwitchHDLHandler();
 
     //Initialize controller handler, HDL state
     virtual ams::Result Initialize() override;
     virtual void Exit() override;
+    virtual void Suspend() override;
 
     //This will be called periodically by the input threads
-    virtual void UpdateInput() override;
+    virtual ams::Result UpdateInput() override;
     //This will be called periodically by the output threads
     virtual void UpdateOutput() override;
 
@@ -32,7 +36,7 @@ public:
 
     //Fills out the HDL state with the specified button data
     void FillHdlState(const NormalizedButtonData &data);
-    //Passes the HDL state to HID so that it could register the inputs
+    //Passes the HDL state to HID so that it could register the inputs, batched with other devices where possible
     ams::Result UpdateHdlState();
 
     static HiddbgHdlsSessionId &GetHdlsSessionId();
@@ -0,0 +1,35 @@
+#include "SwitchPadSlotAllocator.h"
+
+SwitchPadSlotAllocator::SwitchPadSlotAllocator(u32 slotCount)
+{
+    SetSlotCount(slotCount);
+}
+
+void SwitchPadSlotAllocator::SetSlotCount(u32 slotCount)
+{
+    m_slotMask = slotCount >= MaxSlots ? UINT32_MAX : (1u << slotCount) - 1;
+}
+
+s32 SwitchPadSlotAllocator::Acquire()
+{
+    u32 used = m_usedSlots.load(std::memory_order_relaxed);
+    while (true)
+    {
+        u32 free = ~used & m_slotMask;
+        if (free == 0)
+            return InvalidSlot;
+
+        // Find the first zero bit, if someone else took it in the meantime try again with their view of the bitmap
+        u32 slot = __builtin_ctz(free);
+        if (m_usedSlots.compare_exchange_weak(used, used | (1u << slot), std::memory_order_acquire, std::memory_order_relaxed))
+            return slot;
+    }
+}
+
+void SwitchPadSlotAllocator::Release(s32 slot)
+{
+    if (slot < 0 || static_cast<u32>(slot) >= MaxSlots)
+        return;
+
+    m_usedSlots.fetch_and(~(1u << slot), std::memory_order_release);
+}
\ No newline at end of file
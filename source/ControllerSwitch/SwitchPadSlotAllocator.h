@@ -0,0 +1,27 @@
+#pragma once
+#include <switch.h>
+#include <atomic>
+
+// Hands out the virtual pad slots that every kind of gamepad handler is placed in.
+// Slots are kept in an atomic bitmap, so they can be taken and given back from any thread without a lock.
+class SwitchPadSlotAllocator
+{
+private:
+    std::atomic<u32> m_usedSlots{0};
+    u32 m_slotMask;
+
+public:
+    static constexpr s32 InvalidSlot = -1;
+    static constexpr u32 MaxSlots = 32;
+
+    SwitchPadSlotAllocator(u32 slotCount);
+
+    // Only call this while no slot is taken
+    void SetSlotCount(u32 slotCount);
+
+    // Take the lowest free slot. Returns InvalidSlot if all of them are taken
+    s32 Acquire();
+    void Release(s32 slot);
+
+    inline bool IsExhausted() const { return (m_usedSlots.load(std::memory_order_acquire) & m_slotMask) == m_slotMask; }
+};
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include "SwitchTrace.h"
+
+namespace
+{
+    struct TraceRing
+    {
+        TraceRecord records[SwitchTrace::RingSize];
+        // Only advanced by the thread that owns the ring
+        std::atomic<u32> head{0};
+        // Only advanced by the thread that drains the rings
+        u32 tail = 0;
+        std::atomic<bool> used{false};
+    };
+
+    TraceRing g_rings[SwitchTrace::MaxRings];
+
+    thread_local TraceRing *t_ring = nullptr;
+    thread_local bool t_attached = false;
+
+    TraceRing *ClaimRing()
+    {
+        for (u32 i = 0; i != SwitchTrace::MaxRings; ++i)
+        {
+            bool expected = false;
+            if (g_rings[i].used.compare_exchange_strong(expected, true, std::memory_order_acquire))
+                return &g_rings[i];
+        }
+        return nullptr;
+    }
+} // namespace
+
+void SwitchTrace::SetEnabled(bool enabled)
+{
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void SwitchTrace::AttachThread()
+{
+    t_attached = true;
+}
+
+void SwitchTrace::DetachThread()
+{
+    t_attached = false;
+    if (t_ring == nullptr)
+        return;
+
+    // Whatever is left in the ring is still read out, the next owner carries on after it
+    t_ring->used.store(false, std::memory_order_release);
+    t_ring = nullptr;
+}
+
+void SwitchTrace::Push(TraceEvent event, u8 argCount, const u32 (&args)[3])
+{
+    TraceRing *ring = t_ring;
+    if (ring == nullptr)
+    {
+        if (!t_attached)
+            return;
+
+        ring = ClaimRing();
+        if (ring == nullptr)
+        {
+            s_droppedCount.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        t_ring = ring;
+
+        // Rings are reused, so tell the decoder which thread this one belongs to from now on
+        u64 threadId = 0;
+        svcGetThreadId(&threadId, CUR_THREAD_HANDLE);
+        Push(TraceEvent_ThreadAttach, 1, {static_cast<u32>(threadId), 0, 0});
+    }
+
+    u32 head = ring->head.load(std::memory_order_relaxed);
+    TraceRecord &record = ring->records[head % RingSize];
+    record.tick = armGetSystemTick();
+    record.event = event;
+    record.ring = static_cast<u8>(ring - g_rings);
+    record.argCount = argCount;
+    record.args[0] = args[0];
+    record.args[1] = args[1];
+    record.args[2] = args[2];
+
+    ring->head.store(head + 1, std::memory_order_release);
+}
+
+size_t SwitchTrace::Drain(TraceRecord *out, size_t maxCount)
+{
+    size_t count = 0;
+
+    if (maxCount != 0)
+    {
+        if (u32 dropped = s_droppedCount.exchange(0, std::memory_order_relaxed); dropped != 0)
+            out[count++] = TraceRecord{armGetSystemTick(), TraceEvent_Dropped, static_cast<u8>(MaxRings), 1, {dropped, 0, 0}};
+    }
+
+    for (u32 i = 0; i != MaxRings && count != maxCount; ++i)
+    {
+        TraceRing &ring = g_rings[i];
+        u32 head = ring.head.load(std::memory_order_acquire);
+
+        while (ring.tail != head && count != maxCount)
+        {
+            // The slot at head may be in the middle of being written, so a ring that is full counts as overrun too
+            if (head - ring.tail >= RingSize)
+            {
+                u32 lost = head - ring.tail - RingSize + 1;
+                ring.tail += lost;
+                out[count++] = TraceRecord{armGetSystemTick(), TraceEvent_Lost, static_cast<u8>(i), 1, {lost, 0, 0}};
+                continue;
+            }
+
+            out[count] = ring.records[ring.tail % RingSize];
+
+            // If the owner lapped us while we were copying, the copy may be torn and has to be thrown away
+            std::atomic_thread_fence(std::memory_order_acquire);
+            head = ring.head.load(std::memory_order_relaxed);
+            if (head - ring.tail >= RingSize)
+                continue;
+
+            ++ring.tail;
+            ++count;
+        }
+    }
+
+    return count;
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+#include <switch.h>
+#include <atomic>
+
+// Events of the binary trace. The names below are written into the trace file, so the decoder doesn't need to know them
+enum TraceEvent : u16
+{
+    TraceEvent_ThreadAttach, // thread id
+    TraceEvent_Lost,         // number of records of the ring that were overwritten before they could be read out
+    TraceEvent_InputRead,    // interface id
+    TraceEvent_InputFailed,  // interface id, failures in a row
+    TraceEvent_HdlSubmit,    // number of devices
+    TraceEvent_HdlDropped,   // aggregator slot
+    TraceEvent_HdlReattach,  // aggregator slot
+    TraceEvent_Dropped,      // number of records of threads that couldn't get a ring, ring is MaxRings
+    TraceEvent_Count,
+};
+
+struct TraceRecord
+{
+    u64 tick;
+    u16 event;
+    // Index of the ring the record came from, which stands for the thread that recorded it
+    u8 ring;
+    u8 argCount;
+    u32 args[3];
+};
+static_assert(sizeof(TraceRecord) == 24);
+
+// Compact event trace for looking at timings on the hot paths, formatted on the host by tools/decode_trace.py.
+// Every worker thread records into a ring of its own, so recording an event is a tick read and a few stores.
+// A ring that isn't read out in time overwrites its oldest records, which shows up as a Lost event.
+// Records of a thread that couldn't get a ring show up as a Dropped event.
+class SwitchTrace
+{
+public:
+    static constexpr u32 MaxRings = 16;
+    static constexpr u32 RingSize = 128;
+
+    static constexpr const char *EventNames[TraceEvent_Count] = {
+        "ThreadAttach",
+        "Lost",
+        "InputRead",
+        "InputFailed",
+        "HdlSubmit",
+        "HdlDropped",
+        "HdlReattach",
+        "Dropped",
+    };
+
+    static void SetEnabled(bool enabled);
+    static inline bool IsEnabled() { return s_enabled.load(std::memory_order_relaxed); }
+
+    // Let the calling thread record until it calls DetachThread. It takes a ring on its first record, so threads
+    // that never record don't use one up. Records of a thread that finds every ring taken are only counted
+    static void AttachThread();
+    static void DetachThread();
+
+    template <typename... Args>
+    static inline void Record(TraceEvent event, Args... args)
+    {
+        static_assert(sizeof...(Args) <= 3, "A trace event has at most 3 arguments");
+
+        if (IsEnabled())
+            Push(event, sizeof...(Args), {static_cast<u32>(args)...});
+    }
+
+    // Copy out up to maxCount records that haven't been read yet. Only one thread may read at a time
+    static size_t Drain(TraceRecord *out, size_t maxCount);
+
+private:
+    static inline std::atomic<bool> s_enabled{false};
+    static inline std::atomic<u32> s_droppedCount{0};
+
+    static void Push(TraceEvent event, u8 argCount, const u32 (&args)[3]);
+};
\ No newline at end of file
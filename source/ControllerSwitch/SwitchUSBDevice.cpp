@@ -2,6 +2,21 @@
 #include <cstring>  //for memset
 #include "malloc.h" //for memalign
 
+namespace
+{
+    // The path names the port the device hangs off, followed by the interface after a ':'
+    uint32_t HashPortPath(const char *path)
+    {
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i != sizeof(UsbHsInterface::pathstr) && path[i] != '\0' && path[i] != ':'; ++i)
+        {
+            hash ^= static_cast<uint8_t>(path[i]);
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+} // namespace
+
 SwitchUSBDevice::SwitchUSBDevice(UsbHsInterface *interfaces, int length)
 //: m_interfaces(std::vector<std::unique_ptr<IUSBInterface>>())
 {
@@ -21,6 +36,12 @@ ams::Result SwitchUSBDevice::Open()
     if (m_interfaces.size() == 0)
         R_RETURN(51);
 
+    // Drivers open the interfaces again when looking for their endpoints, which is a no-op by then
+    for (auto &&interface : m_interfaces)
+    {
+        R_TRY(interface->Open());
+    }
+
     R_SUCCEED();
 }
 
@@ -47,6 +68,7 @@ void SwitchUSBDevice::SetInterfaces(UsbHsInterface *interfaces, int length)
     {
         m_vendorID = interfaces->device_desc.idVendor;
         m_productID = interfaces->device_desc.idProduct;
+        m_portID = HashPortPath(interfaces->pathstr);
         m_interfaces.clear();
         m_interfaces.reserve(length);
         for (int i = 0; i != length; ++i)
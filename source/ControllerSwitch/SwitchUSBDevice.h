@@ -12,7 +12,7 @@ public:
     // Initialize the class with the SetInterfaces call.
     SwitchUSBDevice(UsbHsInterface *interfaces, int length);
 
-    // There are no devices to open on the switch, so instead this returns success if there are any interfaces
+    // There are no devices to open on the switch, so instead this acquires all of the device's interfaces
     virtual ams::Result Open() override;
     // Closes all the interfaces associated with the class
     virtual void Close() override;
@@ -1,6 +1,7 @@
 #include "SwitchUSBEndpoint.h"
+#include "SwitchUSBTransferPool.h"
 #include <cstring>
-#include <malloc.h>
+#include <algorithm>
 
 SwitchUSBEndpoint::SwitchUSBEndpoint(UsbHsClientIfSession &if_session, usb_endpoint_descriptor &desc)
     : m_ifSession(&if_session),
@@ -10,27 +11,28 @@ SwitchUSBEndpoint::SwitchUSBEndpoint(UsbHsClientIfSession &if_session, usb_endpo
 
 SwitchUSBEndpoint::~SwitchUSBEndpoint()
 {
-    if (m_buffer != nullptr)
-    {
-        ::operator delete[](m_buffer, std::align_val_t(0x1000));
-        m_buffer = nullptr;
-    }
+    SwitchUSBTransferPool::Release(m_buffer);
+    m_buffer = nullptr;
 }
 
 ams::Result SwitchUSBEndpoint::Open(int maxPacketSize)
 {
     maxPacketSize = maxPacketSize != 0 ? maxPacketSize : m_descriptor->wMaxPacketSize;
 
-    R_TRY(usbHsIfOpenUsbEp(m_ifSession, &m_epSession, 1, maxPacketSize, m_descriptor));
-
-    if (m_buffer != nullptr)
-        ::operator delete[](m_buffer, std::align_val_t(0x1000));
+    // A packet always fits in a page, reopening the endpoint keeps the page it already has
+    if (static_cast<size_t>(maxPacketSize) > SwitchUSBTransferPool::PageSize)
+        R_RETURN(-1);
 
-    m_buffer = new (std::align_val_t(0x1000)) u8[maxPacketSize];
+    if (m_buffer == nullptr)
+        m_buffer = SwitchUSBTransferPool::Acquire();
 
     if (m_buffer == nullptr)
         R_RETURN(-1);
 
+    R_TRY(usbHsIfOpenUsbEp(m_ifSession, &m_epSession, 1, maxPacketSize, m_descriptor));
+
+    m_bufferSize = maxPacketSize;
+
     R_SUCCEED();
 }
 
@@ -44,6 +46,10 @@ ams::Result SwitchUSBEndpoint::Write(const void *inBuffer, size_t bufferSize)
     if (m_buffer == nullptr)
         R_RETURN(-1);
 
+    // The transfer buffer only holds a single packet
+    if (bufferSize > m_bufferSize)
+        R_RETURN(-1);
+
     u32 transferredSize = 0;
 
     memcpy(m_buffer, inBuffer, bufferSize);
@@ -55,16 +61,21 @@ ams::Result SwitchUSBEndpoint::Write(const void *inBuffer, size_t bufferSize)
     R_SUCCEED();
 }
 
-ams::Result SwitchUSBEndpoint::Read(void *outBuffer, size_t bufferSize)
+ams::Result SwitchUSBEndpoint::Read(void *outBuffer, size_t bufferSize, size_t *transferredSize)
 {
+    *transferredSize = 0;
+
     if (m_buffer == nullptr)
         R_RETURN(-1);
 
-    u32 transferredSize;
+    // Never let the device write past the packet sized transfer buffer, or past what the caller can take
+    u32 size = std::min(bufferSize, m_bufferSize);
+    u32 postedSize = 0;
 
-    R_TRY(usbHsEpPostBuffer(&m_epSession, m_buffer, bufferSize, &transferredSize));
+    R_TRY(usbHsEpPostBuffer(&m_epSession, m_buffer, size, &postedSize));
 
-    memcpy(outBuffer, m_buffer, transferredSize);
+    *transferredSize = std::min(postedSize, size);
+    memcpy(outBuffer, m_buffer, *transferredSize);
 
     R_SUCCEED();
 }
@@ -11,6 +11,7 @@ private:
     usb_endpoint_descriptor *m_descriptor;
 
     void *m_buffer = nullptr;
+    size_t m_bufferSize = 0;
 
 public:
     // Pass the necessary information to be able to open the endpoint
@@ -25,7 +26,7 @@ public:
     virtual ams::Result Write(const void *inBuffer, size_t bufferSize) override;
 
     // The data received will be put in the outBuffer array for the length of the specified size.
-    virtual ams::Result Read(void *outBuffer, size_t bufferSize) override;
+    virtual ams::Result Read(void *outBuffer, size_t bufferSize, size_t *transferredSize) override;
 
     // Gets the direction of this endpoint (IN or OUT)
     virtual IUSBEndpoint::Direction GetDirection() override;
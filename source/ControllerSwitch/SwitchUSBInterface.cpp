@@ -1,6 +1,6 @@
 #include "SwitchUSBInterface.h"
 #include "SwitchUSBEndpoint.h"
-#include <malloc.h>
+#include "SwitchUSBTransferPool.h"
 #include <cstring>
 
 SwitchUSBInterface::SwitchUSBInterface(UsbHsInterface &interface)
@@ -10,10 +10,14 @@ SwitchUSBInterface::SwitchUSBInterface(UsbHsInterface &interface)
 
 SwitchUSBInterface::~SwitchUSBInterface()
 {
+    Close();
 }
 
 ams::Result SwitchUSBInterface::Open()
 {
+    if (m_isOpen)
+        R_SUCCEED();
+
     UsbHsClientIfSession temp;
     R_TRY(usbHsAcquireUsbIf(&temp, &m_interface));
 
@@ -37,11 +41,15 @@ ams::Result SwitchUSBInterface::Open()
         }
     }
 
+    m_isOpen = true;
     R_SUCCEED();
 }
 
 void SwitchUSBInterface::Close()
 {
+    if (!m_isOpen)
+        return;
+
     for (auto &&endpoint : m_inEndpoints)
     {
         if (endpoint)
@@ -57,15 +65,18 @@ void SwitchUSBInterface::Close()
         }
     }
     usbHsIfClose(&m_session);
+    m_isOpen = false;
 }
 
 ams::Result SwitchUSBInterface::ControlTransfer(u8 bmRequestType, u8 bmRequest, u16 wValue, u16 wIndex, u16 wLength, void *buffer)
 {
-    void *temp_buffer = new (std::align_val_t(0x1000)) u8[wLength];
-    ON_SCOPE_EXIT { ::operator delete[](temp_buffer, std::align_val_t(0x1000)); };
+    if (wLength > SwitchUSBTransferPool::PageSize)
+        R_RETURN(-1);
 
+    void *temp_buffer = SwitchUSBTransferPool::Acquire();
     if (temp_buffer == nullptr)
-        return -1;
+        R_RETURN(-1);
+    ON_SCOPE_EXIT { SwitchUSBTransferPool::Release(temp_buffer); };
 
     u32 transferredSize;
 
@@ -80,11 +91,13 @@ ams::Result SwitchUSBInterface::ControlTransfer(u8 bmRequestType, u8 bmRequest,
 
 ams::Result SwitchUSBInterface::ControlTransfer(u8 bmRequestType, u8 bmRequest, u16 wValue, u16 wIndex, u16 wLength, const void *buffer)
 {
-    void *temp_buffer = new (std::align_val_t(0x1000)) u8[wLength];
-    ON_SCOPE_EXIT { ::operator delete[](temp_buffer, std::align_val_t(0x1000)); };
+    if (wLength > SwitchUSBTransferPool::PageSize)
+        R_RETURN(-1);
 
+    void *temp_buffer = SwitchUSBTransferPool::Acquire();
     if (temp_buffer == nullptr)
-        return -1;
+        R_RETURN(-1);
+    ON_SCOPE_EXIT { SwitchUSBTransferPool::Release(temp_buffer); };
 
     u32 transferredSize;
 
@@ -8,6 +8,7 @@ class SwitchUSBInterface : public IUSBInterface
 private:
     UsbHsClientIfSession m_session;
     UsbHsInterface m_interface;
+    bool m_isOpen = false;
 
     std::array<std::unique_ptr<IUSBEndpoint>, 15> m_inEndpoints;
     std::array<std::unique_ptr<IUSBEndpoint>, 15> m_outEndpoints;
@@ -17,7 +18,7 @@ public:
     SwitchUSBInterface(UsbHsInterface &interface);
     ~SwitchUSBInterface();
 
-    // Open and close the interface
+    // Open and close the interface. Opening an interface that is already open does nothing
     virtual ams::Result Open() override;
     virtual void Close() override;
 
@@ -0,0 +1,25 @@
+#include "SwitchUSBTransferPool.h"
+#include <algorithm>
+
+void SwitchUSBTransferPool::SetPages(Page *pages, u32 pageCount)
+{
+    s_pages = pages;
+    s_allocator.SetSlotCount(std::min(pageCount, MaxPages));
+}
+
+void *SwitchUSBTransferPool::Acquire()
+{
+    s32 index = s_allocator.Acquire();
+    if (index == SwitchPadSlotAllocator::InvalidSlot)
+        return nullptr;
+
+    return s_pages[index].data;
+}
+
+void SwitchUSBTransferPool::Release(void *buffer)
+{
+    if (buffer == nullptr)
+        return;
+
+    s_allocator.Release(reinterpret_cast<Page *>(buffer) - s_pages);
+}
\ No newline at end of file
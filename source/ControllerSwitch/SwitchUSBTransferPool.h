@@ -0,0 +1,29 @@
+#pragma once
+#include <switch.h>
+#include "SwitchPadSlotAllocator.h"
+
+// usbHs only transfers from and to page aligned buffers, so every one of them would take up a whole page of the heap.
+// Instead they come out of pages the sysmodule reserves at build time, which are enough for every controller it can hold.
+class SwitchUSBTransferPool
+{
+public:
+    static constexpr size_t PageSize = 0x1000;
+    static constexpr u32 MaxPages = SwitchPadSlotAllocator::MaxSlots;
+
+    struct alignas(PageSize) Page
+    {
+        u8 data[PageSize];
+    };
+
+    // Only call this while no page is taken
+    static void SetPages(Page *pages, u32 pageCount);
+
+    // Take a free page. Returns nullptr if all of them are taken
+    static void *Acquire();
+    static void Release(void *buffer);
+
+private:
+    static inline Page *s_pages = nullptr;
+    // Pages are taken by the endpoints and control transfers of any handler thread, the bitmap keeps that lock free
+    static inline SwitchPadSlotAllocator s_allocator{0};
+};
\ No newline at end of file
@@ -1,8 +1,33 @@
 #include "SwitchVirtualGamepadHandler.h"
+#include "SwitchUSBInterface.h"
+#include "ControllerHelpers.h"
+#include "SwitchTrace.h"
+#include "../Sysmodule/source/results.h"
+#include <algorithm>
 
-SwitchVirtualGamepadHandler::SwitchVirtualGamepadHandler(std::unique_ptr<IController> &&controller)
-    : m_controller(std::move(controller))
+namespace
 {
+    // Failures past this count are no longer retried right away
+    constexpr u32 TransientFailureLimit = 4;
+    // Once this many reads fail in a row the device is reset, if the reads keep failing after that it is considered gone
+    constexpr u32 InputFailureBudget = 32;
+
+    constexpr s64 MinInputBackoffNs = 1'000'000;
+    constexpr s64 MaxInputBackoffNs = 100'000'000;
+} // namespace
+
+SwitchVirtualGamepadHandler::SwitchVirtualGamepadHandler(std::unique_ptr<IController> &&controller, GamepadHandlerStacks *stacks)
+    : m_controller(std::move(controller)),
+      m_stacks(stacks)
+{
+    // The interfaces are acquired before the handler is made, so their session IDs are already valid
+    for (auto &&interface : m_controller->GetDevice()->GetInterfaces())
+    {
+        if (m_interfaceIdCount == m_interfaceIds.size())
+            break;
+        m_interfaceIds[m_interfaceIdCount++] = static_cast<SwitchUSBInterface *>(interface.get())->GetID();
+    }
+    std::sort(m_interfaceIds.begin(), m_interfaceIds.begin() + m_interfaceIdCount);
 }
 
 SwitchVirtualGamepadHandler::~SwitchVirtualGamepadHandler()
@@ -19,52 +44,128 @@ void SwitchVirtualGamepadHandler::Exit()
     m_controller->Exit();
 }
 
+void SwitchVirtualGamepadHandler::Suspend()
+{
+    // Joining a thread that was never started does nothing, so this is fine for controllers that support nothing
+    ExitInputThread();
+    ExitOutputThread();
+    m_isSuspended = true;
+}
+
+ams::Result SwitchVirtualGamepadHandler::Resume()
+{
+    if (!m_isSuspended)
+        R_SUCCEED();
+    m_isSuspended = false;
+
+    R_TRY(m_controller->Resume());
+
+    if (DoesControllerSupport(m_controller->GetType(), SUPPORTS_NOTHING))
+        R_SUCCEED();
+
+    // Reads that failed while the bus went down shouldn't count against the device
+    m_inputFailureCount = 0;
+    m_deviceResetAttempted = false;
+
+    if (DoesControllerSupport(m_controller->GetType(), SUPPORTS_PAIRING))
+    {
+        R_TRY(InitOutputThread());
+    }
+
+    R_TRY(InitInputThread());
+
+    R_SUCCEED();
+}
+
 void SwitchVirtualGamepadHandler::InputThreadLoop(void *handler)
 {
-    do
+    SwitchVirtualGamepadHandler *self = static_cast<SwitchVirtualGamepadHandler *>(handler);
+
+    ams::Result rc = self->UpdateInput();
+    if (R_SUCCEEDED(rc))
+    {
+        SwitchTrace::Record(TraceEvent_InputRead, self->m_interfaceIds[0]);
+        self->m_inputCount.fetch_add(1, std::memory_order_relaxed);
+        self->m_inputFailureCount = 0;
+        self->m_deviceResetAttempted = false;
+    }
+    else if (self->HandleInputFailure(rc) == InputFailure_Gone)
     {
-        static_cast<SwitchVirtualGamepadHandler *>(handler)->UpdateInput();
-    } while (static_cast<SwitchVirtualGamepadHandler *>(handler)->m_inputThreadIsRunning);
+        // Leave the thread parked, the handler gets removed once the interface goes away
+        self->m_deviceLost.store(true, std::memory_order_release);
+        self->m_inputThread.RequestStop();
+        if (s_deviceLostCallback != nullptr)
+            s_deviceLostCallback();
+    }
 }
 
 void SwitchVirtualGamepadHandler::OutputThreadLoop(void *handler)
 {
-    do
+    static_cast<SwitchVirtualGamepadHandler *>(handler)->UpdateOutput();
+}
+
+InputFailure SwitchVirtualGamepadHandler::HandleInputFailure(ams::Result rc)
+{
+    // A Join cancels the read in progress, that's not the device's fault
+    if (ams::svc::ResultCancelled::Includes(rc))
+        return InputFailure_Transient;
+
+    ++m_inputFailureCount;
+    m_failedInputCount.fetch_add(1, std::memory_order_relaxed);
+    SwitchTrace::Record(TraceEvent_InputFailed, m_interfaceIds[0], m_inputFailureCount);
+
+    // usb:hs closes the sessions of an interface once its device is unplugged, no retry or reset brings it back
+    if (ams::svc::ResultSessionClosed::Includes(rc))
+        return InputFailure_Gone;
+
+    // Anything else could be a hiccup, it's only given up on once it keeps failing
+    if (m_inputFailureCount <= TransientFailureLimit)
+        return InputFailure_Transient;
+
+    if (m_inputFailureCount >= InputFailureBudget)
     {
-        static_cast<SwitchVirtualGamepadHandler *>(handler)->UpdateOutput();
-    } while (static_cast<SwitchVirtualGamepadHandler *>(handler)->m_outputThreadIsRunning);
+        if (m_deviceResetAttempted)
+            return InputFailure_Gone;
+
+        // A reset re-enumerates the device, so if it is still there it will be picked up again from scratch
+        m_deviceResetAttempted = true;
+        m_inputFailureCount = TransientFailureLimit;
+        m_deviceResetCount.fetch_add(1, std::memory_order_relaxed);
+        m_controller->GetDevice()->Reset();
+    }
+
+    // Right after a reset the count sits at TransientFailureLimit, which has to start at the shortest backoff
+    s32 shift = std::clamp(static_cast<s32>(m_inputFailureCount) - static_cast<s32>(TransientFailureLimit) - 1, 0, 16);
+    m_inputThread.Sleep(std::min(MinInputBackoffNs << shift, MaxInputBackoffNs));
+    return InputFailure_Stalled;
 }
 
 ams::Result SwitchVirtualGamepadHandler::InitInputThread()
 {
-    m_inputThreadIsRunning = true;
-    R_ABORT_UNLESS(threadCreate(&m_inputThread, &SwitchVirtualGamepadHandler::InputThreadLoop, this, input_thread_stack, sizeof(input_thread_stack), 0x30, -2));
-    R_ABORT_UNLESS(threadStart(&m_inputThread));
-    R_SUCCEED();
+    ams::Result rc = m_inputThread.Start(&SwitchVirtualGamepadHandler::InputThreadLoop, this, m_stacks->input, sizeof(m_stacks->input), 0x30);
+    // Already running is what the caller asked for
+    if (syscon::ResultThreadAlreadyRunning::Includes(rc))
+        R_SUCCEED();
+    R_RETURN(rc);
 }
 
 void SwitchVirtualGamepadHandler::ExitInputThread()
 {
-    m_inputThreadIsRunning = false;
-    svcCancelSynchronization(m_inputThread.handle);
-    threadWaitForExit(&m_inputThread);
-    threadClose(&m_inputThread);
+    m_inputThread.Join();
 }
 
 ams::Result SwitchVirtualGamepadHandler::InitOutputThread()
 {
-    m_outputThreadIsRunning = true;
-    R_ABORT_UNLESS(threadCreate(&m_outputThread, &SwitchVirtualGamepadHandler::OutputThreadLoop, this, output_thread_stack, sizeof(output_thread_stack), 0x30, -2));
-    R_ABORT_UNLESS(threadStart(&m_outputThread));
-    R_SUCCEED();
+    ams::Result rc = m_outputThread.Start(&SwitchVirtualGamepadHandler::OutputThreadLoop, this, m_stacks->output, sizeof(m_stacks->output), 0x30);
+    // Already running is what the caller asked for
+    if (syscon::ResultThreadAlreadyRunning::Includes(rc))
+        R_SUCCEED();
+    R_RETURN(rc);
 }
 
 void SwitchVirtualGamepadHandler::ExitOutputThread()
 {
-    m_outputThreadIsRunning = false;
-    svcCancelSynchronization(m_outputThread.handle);
-    threadWaitForExit(&m_outputThread);
-    threadClose(&m_outputThread);
+    m_outputThread.Join();
 }
 
 static_assert(JOYSTICK_MAX == 32767 && JOYSTICK_MIN == -32767,
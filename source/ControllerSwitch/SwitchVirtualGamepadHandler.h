@@ -1,29 +1,78 @@
 #pragma once
 #include <switch.h>
 #include "IController.h"
+#include "SwitchWorkerThread.h"
 #include <stratosphere.hpp>
 
+// How a failed input read is treated by the input thread
+enum InputFailure : uint8_t
+{
+    InputFailure_Transient, // Retry right away
+    InputFailure_Stalled,   // Back off exponentially before retrying
+    InputFailure_Gone,      // The interface is gone or the failure budget is exhausted, stop polling the device
+};
+
+// Thread stacks for a handler's input and output threads. They are provided by whoever owns the handler,
+// so that handlers can be placed in statically reserved memory instead of each carrying 8KB to the heap
+struct GamepadHandlerStacks
+{
+    static constexpr size_t StackSize = 0x1000;
+
+    alignas(ams::os::ThreadStackAlignment) u8 input[StackSize];
+    alignas(ams::os::ThreadStackAlignment) u8 output[StackSize];
+};
+
+// Counters kept by the input thread, for whoever wants to look at how a controller is doing
+struct GamepadHandlerStats
+{
+    u32 inputCount;
+    u32 failedInputCount;
+    u32 deviceResetCount;
+};
+
 // This class is a base class for SwitchHDLHandler and SwitchAbstractedPaadHandler.
 class SwitchVirtualGamepadHandler
 {
+public:
+    // No supported controller is made up of more interfaces than this, discovery doesn't group any more than that either
+    static constexpr size_t MaxInterfaceIds = 4;
+
+    using DeviceLostCallback = void (*)();
+
 protected:
+    static inline DeviceLostCallback s_deviceLostCallback = nullptr;
+
     HidVibrationDeviceHandle m_vibrationDeviceHandle;
     std::unique_ptr<IController> m_controller;
 
-    alignas(ams::os::ThreadStackAlignment) u8 input_thread_stack[0x1000];
-    alignas(ams::os::ThreadStackAlignment) u8 output_thread_stack[0x1000];
+    GamepadHandlerStacks *m_stacks;
+
+    SwitchWorkerThread m_inputThread;
+    SwitchWorkerThread m_outputThread;
 
-    Thread m_inputThread;
-    Thread m_outputThread;
+    // Consecutive failed input reads, reset on the first successful one
+    u32 m_inputFailureCount = 0;
+    bool m_deviceResetAttempted = false;
+    std::atomic<bool> m_deviceLost{false};
+    // Only touched by whoever drives the sleep transitions
+    bool m_isSuspended = false;
 
-    bool m_inputThreadIsRunning = false;
-    bool m_outputThreadIsRunning = false;
+    std::atomic<u32> m_inputCount{0};
+    std::atomic<u32> m_failedInputCount{0};
+    std::atomic<u32> m_deviceResetCount{0};
+
+    // Sorted session IDs of the controller's interfaces, so removal checks don't have to walk the device
+    std::array<s32, MaxInterfaceIds> m_interfaceIds{};
+    size_t m_interfaceIdCount = 0;
 
     static void InputThreadLoop(void *argument);
     static void OutputThreadLoop(void *argument);
 
+    // Classifies a failed input read by its result and sleeps for the matching backoff period
+    InputFailure HandleInputFailure(ams::Result rc);
+
 public:
-    SwitchVirtualGamepadHandler(std::unique_ptr<IController> &&controller);
+    SwitchVirtualGamepadHandler(std::unique_ptr<IController> &&controller, GamepadHandlerStacks *stacks);
     virtual ~SwitchVirtualGamepadHandler();
 
     // Override this if you want a custom init procedure
@@ -31,6 +80,12 @@ public:
     // Override this if you want a custom exit procedure
     virtual void Exit();
 
+    // Park the input and output threads while the console sleeps. The controller, its interfaces and
+    // its virtual device are kept, so Resume can bring it back without going through discovery again
+    virtual void Suspend();
+    // Does nothing for a handler that wasn't suspended, its threads are still running
+    virtual ams::Result Resume();
+
     // Separately init the input-reading thread
     ams::Result InitInputThread();
     // Separately close the input-reading thread
@@ -41,8 +96,8 @@ public:
     // Separately close the rumble sending thread
     void ExitOutputThread();
 
-    // The function to call indefinitely by the input thread
-    virtual void UpdateInput() = 0;
+    // The function to call indefinitely by the input thread, returns the result of reading from the controller
+    virtual ams::Result UpdateInput() = 0;
     // The function to call indefinitely by the output thread
     virtual void UpdateOutput() = 0;
 
@@ -53,4 +108,17 @@ public:
     // Get the raw controller pointer
     inline IController *GetController() { return m_controller.get(); }
     inline HidVibrationDeviceHandle *GetVibrationHandle() { return &m_vibrationDeviceHandle; }
+    // Whether the input thread gave up on the device after too many failed reads
+    inline bool IsDeviceLost() { return m_deviceLost.load(std::memory_order_acquire); }
+    inline bool IsSuspended() { return m_isSuspended; }
+    inline GamepadHandlerStats GetStats()
+    {
+        return {m_inputCount.load(std::memory_order_relaxed), m_failedInputCount.load(std::memory_order_relaxed), m_deviceResetCount.load(std::memory_order_relaxed)};
+    }
+    inline const s32 *GetInterfaceIds() { return m_interfaceIds.data(); }
+
+    // Called from the input thread of a handler that just gave up on its device, so the handler can be removed
+    // without waiting for some unrelated USB event. Set it before any handler is created
+    static inline void SetDeviceLostCallback(DeviceLostCallback callback) { s_deviceLostCallback = callback; }
+    inline size_t GetInterfaceIdCount() { return m_interfaceIdCount; }
 };
\ No newline at end of file
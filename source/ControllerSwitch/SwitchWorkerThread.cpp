@@ -0,0 +1,99 @@
+#include "SwitchWorkerThread.h"
+#include "SwitchTrace.h"
+#include "../Sysmodule/source/results.h"
+
+SwitchWorkerThread::~SwitchWorkerThread()
+{
+    Join();
+}
+
+void SwitchWorkerThread::ThreadFunc(void *worker)
+{
+    SwitchWorkerThread *self = static_cast<SwitchWorkerThread *>(worker);
+    SwitchTrace::AttachThread();
+
+    while (!self->IsStopRequested())
+    {
+        self->m_loopFunc(self->m_argument);
+    }
+
+    SwitchTrace::DetachThread();
+}
+
+ams::Result SwitchWorkerThread::Start(LoopFunc func, void *argument, void *stack, size_t stackSize, int priority)
+{
+    R_UNLESS(!m_isCreated, syscon::ResultThreadAlreadyRunning());
+
+    m_loopFunc = func;
+    m_argument = argument;
+    m_stopRequested.store(false, std::memory_order_release);
+    ueventCreate(&m_wakeEvent, false);
+
+    R_TRY(threadCreate(&m_thread, &SwitchWorkerThread::ThreadFunc, this, stack, stackSize, priority, -2));
+
+    // A thread that never ran can't be joined, so it has to be closed right away
+    if (Result rc = threadStart(&m_thread); R_FAILED(rc))
+    {
+        threadClose(&m_thread);
+        R_RETURN(rc);
+    }
+
+    m_isCreated = true;
+
+    R_SUCCEED();
+}
+
+void SwitchWorkerThread::RequestStop()
+{
+    m_stopRequested.store(true, std::memory_order_release);
+    ueventSignal(&m_wakeEvent);
+}
+
+void SwitchWorkerThread::Join()
+{
+    if (!m_isCreated)
+        return;
+
+    RequestStop();
+
+    // The loop may be blocked inside libnx (e.g. waiting for a USB transfer), where it can't see our wake event.
+    // Cancelling is sticky, so this also covers the case where the thread is between waits right now.
+    svcCancelSynchronization(m_thread.handle);
+
+    threadWaitForExit(&m_thread);
+    threadClose(&m_thread);
+    m_isCreated = false;
+}
+
+bool SwitchWorkerThread::Wait(Waiter waiter, u64 timeout)
+{
+    if (IsStopRequested())
+        return false;
+
+    s32 index = -1;
+    if (R_FAILED(waitMulti(&index, timeout, waiter, waiterForUEvent(&m_wakeEvent))))
+        return false;
+
+    return index == 0 && !IsStopRequested();
+}
+
+s32 SwitchWorkerThread::WaitAny(Waiter first, Waiter second, u64 timeout)
+{
+    if (IsStopRequested())
+        return -1;
+
+    s32 index = -1;
+    if (R_FAILED(waitMulti(&index, timeout, first, second, waiterForUEvent(&m_wakeEvent))))
+        return -1;
+
+    return index < 2 && !IsStopRequested() ? index : -1;
+}
+
+bool SwitchWorkerThread::Sleep(u64 ns)
+{
+    if (IsStopRequested())
+        return false;
+
+    // Nothing but a stop request ever signals the wake event, so running into the timeout means we slept the full time
+    return R_FAILED(waitSingle(waiterForUEvent(&m_wakeEvent), ns)) && !IsStopRequested();
+}
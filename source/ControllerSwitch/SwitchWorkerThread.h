@@ -0,0 +1,48 @@
+#pragma once
+#include <switch.h>
+#include <stratosphere.hpp>
+#include <atomic>
+
+// Wrapper for the sysmodule's worker loops.
+// The loop function is called repeatedly until a stop is requested, and any waiting it does should go through
+// Wait() or Sleep() so that a stop request wakes it up right away instead of relying on the wait timing out.
+class SwitchWorkerThread
+{
+public:
+    using LoopFunc = void (*)(void *argument);
+
+private:
+    Thread m_thread{};
+    UEvent m_wakeEvent{};
+    std::atomic<bool> m_stopRequested{false};
+    bool m_isCreated = false;
+
+    LoopFunc m_loopFunc = nullptr;
+    void *m_argument = nullptr;
+
+    static void ThreadFunc(void *worker);
+
+public:
+    SwitchWorkerThread() = default;
+    ~SwitchWorkerThread();
+
+    SwitchWorkerThread(const SwitchWorkerThread &) = delete;
+    SwitchWorkerThread &operator=(const SwitchWorkerThread &) = delete;
+
+    // Create and start the thread on the given stack. Returns ResultThreadAlreadyRunning if it was started and not joined since
+    ams::Result Start(LoopFunc func, void *argument, void *stack, size_t stackSize, int priority);
+    // Ask the loop to stop after its current iteration and wake it up if it is waiting. Safe to call from the loop itself
+    void RequestStop();
+    // Request a stop and wait for the thread to exit. Does nothing if the thread was never started
+    void Join();
+
+    inline bool IsStopRequested() const { return m_stopRequested.load(std::memory_order_acquire); }
+    inline bool IsRunning() const { return m_isCreated; }
+
+    // Wait for the waiter to be signaled. Returns false if it timed out or a stop was requested
+    bool Wait(Waiter waiter, u64 timeout = UINT64_MAX);
+    // Wait for either of the waiters to be signaled. Returns the index of the one that was, or -1 if it timed out or a stop was requested
+    s32 WaitAny(Waiter first, Waiter second, u64 timeout = UINT64_MAX);
+    // Sleep for the given time. Returns false if the sleep was cut short by a stop request
+    bool Sleep(u64 ns);
+};
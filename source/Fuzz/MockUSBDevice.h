@@ -0,0 +1,113 @@
+#pragma once
+#include "IUSBDevice.h"
+#include <cstring>
+
+// A device that plays back the fuzz input as its reports. The input is a series of reports, each one
+// a length byte followed by that many bytes. Reads fail once the input runs out, which ends the run
+class MockUSBEndpoint : public IUSBEndpoint
+{
+private:
+    Direction m_direction;
+    EndpointDescriptor m_descriptor;
+    const uint8_t *&m_data;
+    size_t &m_size;
+
+public:
+    MockUSBEndpoint(Direction direction, const uint8_t *&data, size_t &size)
+        : m_direction(direction), m_descriptor{7, 5, static_cast<uint8_t>(direction | 1), 3, 64, 1}, m_data(data), m_size(size)
+    {
+    }
+
+    virtual ams::Result Open(int maxPacketSize = 0) override
+    {
+        AMS_UNUSED(maxPacketSize);
+        R_SUCCEED();
+    }
+    virtual void Close() override {}
+
+    virtual ams::Result Write(const void *inBuffer, size_t bufferSize) override
+    {
+        AMS_UNUSED(inBuffer, bufferSize);
+        R_SUCCEED();
+    }
+
+    virtual ams::Result Read(void *outBuffer, size_t bufferSize, size_t *transferredSize) override
+    {
+        *transferredSize = 0;
+        if (m_size == 0)
+            R_RETURN(1);
+
+        size_t reportSize = std::min<size_t>(m_data[0], m_size - 1);
+        // Like the real endpoint, a report longer than the buffer is cut off
+        *transferredSize = std::min(reportSize, bufferSize);
+        std::memcpy(outBuffer, m_data + 1, *transferredSize);
+
+        m_data += reportSize + 1;
+        m_size -= reportSize + 1;
+        R_SUCCEED();
+    }
+
+    virtual Direction GetDirection() override { return m_direction; }
+    virtual EndpointDescriptor *GetDescriptor() override { return &m_descriptor; }
+};
+
+class MockUSBInterface : public IUSBInterface
+{
+private:
+    InterfaceDescriptor m_descriptor;
+    MockUSBEndpoint m_inEndpoint;
+    MockUSBEndpoint m_outEndpoint;
+
+public:
+    MockUSBInterface(uint8_t interfaceClass, uint8_t interfaceProtocol, const uint8_t *&data, size_t &size)
+        : m_descriptor{9, 4, 0, 0, 2, interfaceClass, 0, interfaceProtocol, 0},
+          m_inEndpoint(IUSBEndpoint::USB_ENDPOINT_IN, data, size),
+          m_outEndpoint(IUSBEndpoint::USB_ENDPOINT_OUT, data, size)
+    {
+    }
+
+    virtual ams::Result Open() override { R_SUCCEED(); }
+    virtual void Close() override {}
+
+    virtual ams::Result ControlTransfer(uint8_t bmRequestType, uint8_t bmRequest, uint16_t wValue, uint16_t wIndex, uint16_t wLength, void *buffer) override
+    {
+        AMS_UNUSED(bmRequestType, bmRequest, wValue, wIndex);
+        std::memset(buffer, 0, wLength);
+        R_SUCCEED();
+    }
+    virtual ams::Result ControlTransfer(uint8_t bmRequestType, uint8_t bmRequest, uint16_t wValue, uint16_t wIndex, uint16_t wLength, const void *buffer) override
+    {
+        AMS_UNUSED(bmRequestType, bmRequest, wValue, wIndex, wLength, buffer);
+        R_SUCCEED();
+    }
+
+    virtual IUSBEndpoint *GetEndpoint(IUSBEndpoint::Direction direction, uint8_t index) override
+    {
+        if (index != 0)
+            return nullptr;
+        return direction == IUSBEndpoint::USB_ENDPOINT_IN ? &m_inEndpoint : &m_outEndpoint;
+    }
+    virtual InterfaceDescriptor *GetDescriptor() override { return &m_descriptor; }
+
+    virtual ams::Result Reset() override { R_SUCCEED(); }
+};
+
+class MockUSBDevice : public IUSBDevice
+{
+private:
+    const uint8_t *m_data;
+    size_t m_size;
+
+public:
+    MockUSBDevice(uint16_t vendorId, uint16_t productId, uint8_t interfaceClass, uint8_t interfaceProtocol, const uint8_t *data, size_t size)
+        : m_data(data), m_size(size)
+    {
+        m_vendorID = vendorId;
+        m_productID = productId;
+        m_interfaces.push_back(std::make_unique<MockUSBInterface>(interfaceClass, interfaceProtocol, m_data, m_size));
+    }
+
+    virtual ams::Result Open() override { R_SUCCEED(); }
+    virtual void Close() override {}
+    virtual void Reset() override {}
+};
\ No newline at end of file
@@ -0,0 +1,51 @@
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <vector>
+
+// Stands in for libFuzzer's main when the compiler doesn't have it: runs every file given, or every file
+// in the directories given, through the target once. Options meant for libFuzzer are skipped
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+namespace
+{
+    void RunFile(const std::filesystem::path &path)
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<uint8_t> data{std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>()};
+        LLVMFuzzerTestOneInput(data.data(), data.size());
+    }
+} // namespace
+
+int main(int argc, char **argv)
+{
+    size_t runs = 0;
+    for (int i = 1; i != argc; ++i)
+    {
+        if (argv[i][0] == '-')
+            continue;
+
+        std::filesystem::path path(argv[i]);
+        if (std::filesystem::is_directory(path))
+        {
+            for (const auto &entry : std::filesystem::recursive_directory_iterator(path))
+            {
+                if (entry.is_regular_file())
+                {
+                    RunFile(entry.path());
+                    ++runs;
+                }
+            }
+        }
+        else
+        {
+            RunFile(path);
+            ++runs;
+        }
+    }
+
+    std::printf("Ran %zu inputs\n", runs);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,30 @@
+#include "config_parser.h"
+#include "ini.h"
+#include <string>
+
+namespace
+{
+    syscon::config::ParsedConfig parsed;
+    DeviceEntry device;
+
+    // Takes the lines of any config file, devices.ini sections included, the same way config_handler.cpp hands them over
+    int ParseLine(void *user, const char *section, const char *name, const char *value)
+    {
+        AMS_UNUSED(user, section);
+
+        if (syscon::config::ParseDeviceValue(&device, name, value))
+            return 1;
+        return syscon::config::ParseConfigValue(&parsed, name, value) ? 1 : 0;
+    }
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    parsed = syscon::config::ParsedConfig{};
+    device = DeviceEntry{};
+
+    // ini_parse_string stops at the first null, like a config file read into memory would
+    std::string text(reinterpret_cast<const char *>(data), size);
+    ini_parse_string(text.c_str(), ParseLine, nullptr);
+    return 0;
+}
\ No newline at end of file
@@ -0,0 +1,20 @@
+#include "MockUSBDevice.h"
+#include "Controllers.h"
+
+// Built once per driver, FUZZ_DRIVER names its class and the interface it needs is given along with it by CMakeLists.txt.
+// Every report of the input goes through GetInput and GetNormalizedButtonData, as the input thread would do
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    FUZZ_DRIVER controller(std::make_unique<MockUSBDevice>(FUZZ_VENDOR_ID, FUZZ_PRODUCT_ID, FUZZ_INTERFACE_CLASS, FUZZ_INTERFACE_PROTOCOL, data, size));
+    if (R_FAILED(controller.Initialize()))
+        return 0;
+
+    while (R_SUCCEEDED(controller.GetInput()))
+    {
+        NormalizedButtonData normalData = controller.GetNormalizedButtonData();
+        AMS_UNUSED(normalData);
+    }
+
+    controller.Exit();
+    return 0;
+}
\ No newline at end of file
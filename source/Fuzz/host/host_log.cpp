@@ -0,0 +1,25 @@
+#include "log.h"
+#include <strings.h>
+#include <iterator>
+
+// The log only goes to the SD card, on the host the lines are dropped. The level names match log.cpp
+bool ParseLogLevel(const char *name, LogLevel *out)
+{
+    constexpr const char *levelNames[] = {"debug", "info", "warning", "error", "none"};
+    static_assert(std::size(levelNames) == LogLevel_None + 1);
+
+    for (u8 i = 0; i != std::size(levelNames); ++i)
+    {
+        if (strcasecmp(name, levelNames[i]) == 0)
+        {
+            *out = static_cast<LogLevel>(i);
+            return true;
+        }
+    }
+    return false;
+}
+
+void WriteToLog(const char *fmt, ...)
+{
+    (void)fmt;
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#pragma once
+// Stands in for libstratosphere on the host, just enough of it for ControllerLib and the config parser
+#include <switch.h>
+#include <cstdarg>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <array>
+
+namespace ams
+{
+    class Result
+    {
+    public:
+        constexpr Result(u32 value = 0) : m_value(value) {}
+
+        constexpr u32 GetValue() const { return m_value; }
+        constexpr bool IsSuccess() const { return m_value == 0; }
+        constexpr bool IsFailure() const { return m_value != 0; }
+
+    private:
+        u32 m_value;
+    };
+
+    namespace os
+    {
+        class Mutex
+        {
+        public:
+            explicit Mutex(bool) {}
+
+            void lock() { m_mutex.lock(); }
+            void unlock() { m_mutex.unlock(); }
+            bool try_lock() { return m_mutex.try_lock(); }
+
+        private:
+            std::recursive_mutex m_mutex;
+        };
+    } // namespace os
+
+    namespace impl
+    {
+        template <typename... Args>
+        constexpr void Unused(Args &&...) {}
+    } // namespace impl
+
+    namespace util
+    {
+        inline int TSNPrintf(char *dst, size_t dst_size, const char *fmt, ...)
+        {
+            va_list args;
+            va_start(args, fmt);
+            int written = std::vsnprintf(dst, dst_size, fmt, args);
+            va_end(args);
+            return written;
+        }
+    } // namespace util
+} // namespace ams
+
+#undef R_SUCCEEDED
+#undef R_FAILED
+#define R_SUCCEEDED(res) (::ams::Result(res).IsSuccess())
+#define R_FAILED(res)    (::ams::Result(res).IsFailure())
+
+#define R_SUCCEED()    return ::ams::Result(0)
+#define R_RETURN(expr) return ::ams::Result(expr)
+#define R_TRY(expr)                                    \
+    do                                                 \
+    {                                                  \
+        const ::ams::Result _r_try_result = (expr);    \
+        if (_r_try_result.IsFailure())                 \
+            return _r_try_result;                      \
+    } while (false)
+
+#define AMS_UNUSED(...) ::ams::impl::Unused(__VA_ARGS__)
\ No newline at end of file
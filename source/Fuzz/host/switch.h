@@ -0,0 +1,15 @@
+#pragma once
+// Stands in for libnx on the host, only the integer types and macros the fuzzed code uses
+#include <cstdint>
+#include <cstddef>
+
+typedef uint8_t u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int8_t s8;
+typedef int16_t s16;
+typedef int32_t s32;
+typedef int64_t s64;
+
+#define BIT(n) (1U << (n))
\ No newline at end of file
@@ -1,313 +1,892 @@
 #include <switch.h>
 #include "config_handler.h"
+#include "config_parser.h"
 #include "Controllers.h"
 #include "ControllerConfig.h"
+#include "ControllerDatabase.h"
 #include "log.h"
 #include "ini.h"
 #include <cstring>
+#include <algorithm>
+#include <bit>
 #include <stratosphere.hpp>
 #include "usb_module.h"
+#include "SwitchWorkerThread.h"
+#include "SwitchHDLAggregator.h"
+#include "SwitchTrace.h"
+#include "results.h"
 
 namespace syscon::config
 {
     namespace
     {
-        ControllerConfig tempConfig;
-        GlobalConfig tempGlobalConfig;
-        RGBAColor tempColor;
-        char firmwarePath[100];
+        // What the file being parsed set, its masks let a profile only override those
+        ParsedConfig tempParsed;
 
-        UTimer filecheckTimer;
-        Waiter filecheckTimerWaiter = waiterForUTimer(&filecheckTimer);
+        // devices.ini has one section per device, the entry is added once its section ends
+        DeviceEntry tempDevice;
+        char tempDeviceSection[64];
+        u32 userDeviceCount;
+        u32 deviceProfileCount;
+
+        // Config keys given in a devices.ini section, applied over the driver's config for that vid/pid
+        constexpr size_t MaxDeviceProfiles = 16;
+
+        struct DeviceProfile
+        {
+            u16 vendor_id;
+            u16 product_id;
+            ConfigOverrides overrides;
+        };
+
+        // titles/<program id>.ini, applied over the config of every controller while that title is in the foreground
+        constexpr size_t MaxTitleProfiles = 32;
+
+        struct TitleProfile
+        {
+            u64 programId;
+            ConfigOverrides overrides;
+        };
+
+        // Sorted by program id. The table in use, and the one the next load is parsed into without holding configMutex
+        TitleProfile titleProfileTables[2][MaxTitleProfiles];
+        TitleProfile *titleProfiles = titleProfileTables[0];
+        u32 titleProfileCount;
+        // Only touched by whoever loads the title profiles
+        ParsedConfig titleParsed;
+        u64 activeProgramId;
+        const ConfigOverrides *activeTitleOverrides;
+
+        // Values pushed through the control service. They win over everything else until their file is reloaded
+        ConfigOverrides runtimeOverrides[ConfigFile_Count];
+        // The Dualshock 4's light bar color isn't part of ControllerConfig, it is in use while its key is in runtimeOverrides
+        RGBAColor runtimeLedColor;
+
+        // The parsed results of every config file, written to the SD card so the next boot can skip the INI parsing.
+        // An entry is only used while its file still has the timestamp it was parsed at
+        constexpr const char ConfigCachePath[] = "sdmc:" CONFIG_PATH "config.cache";
+        constexpr u32 ConfigCacheMagic = 0x43435953; // "SYCC"
+        // Bump whenever the layout below or any of the structs in it change
+        constexpr u32 ConfigCacheVersion = 5;
+
+        struct ConfigCache
+        {
+            u32 magic;
+            u32 version;
+            // BIT(ConfigFile) of the files that were read successfully, the others are left alone like a failed read would
+            u32 validFiles;
+            u32 deviceCount;
+            u64 timestamps[ConfigFile_Count];
+            GlobalConfig global;
+            ControllerConfig controllers[ConfigFile_Count];
+            RGBAColor ledColor;
+            DeviceEntry devices[MaxUserDevices];
+            u32 profileCount;
+            DeviceProfile profiles[MaxDeviceProfiles];
+        };
+
+        ConfigCache configCache{ConfigCacheMagic, ConfigCacheVersion};
+        // Only touched by whoever writes the cache, so the SD card write happens outside of configMutex
+        ConfigCache configCacheCopy;
+        bool configCacheDirty = false;
+
+        // How long the config thread waits between checks. It backs off while nothing changes, but never so far
+        // that an edit takes more than a few seconds to be picked up
+        constexpr u64 MinCheckIntervalNs = 1'000'000'000;
+        constexpr u64 MaxCheckIntervalNs = 4'000'000'000;
+        u64 checkIntervalNs = MinCheckIntervalNs;
+        // Once polling has settled at the longest interval, every this many wakes also read the title profiles again
+        constexpr u32 FullCheckEveryWakes = 8;
+        u32 steadyWakeCount = 0;
+
+        // Signalled to make the config thread check every file right away
+        UEvent g_reloadRequestEvent;
 
         // Thread to check for any config changes
         void ConfigChangedCheckThreadFunc(void *);
 
         alignas(ams::os::ThreadStackAlignment) u8 config_thread_stack[0x2000];
-        Thread g_config_changed_check_thread;
-
-        bool is_config_changed_check_thread_running = false;
-
-        constexpr std::array keyNames{
-            "DEFAULT",
-            "NONE",
-            "FACE_UP",
-            "FACE_RIGHT",
-            "FACE_DOWN",
-            "FACE_LEFT",
-            "LSTICK_CLICK",
-            "RSTICK_CLICK",
-            "LEFT_BUMPER",
-            "RIGHT_BUMPER",
-            "LEFT_TRIGGER",
-            "RIGHT_TRIGGER",
-            "BACK",
-            "START",
-            "DPAD_UP",
-            "DPAD_RIGHT",
-            "DPAD_DOWN",
-            "DPAD_LEFT",
-            "CAPTURE",
-            "HOME",
-            "SYNC",
-            "TOUCHPAD",
-        };
+        SwitchWorkerThread g_config_changed_check_thread;
 
-        ControllerButton StringToKey(const char *text)
+        // Parses into the given ParsedConfig, or tempParsed if there is none
+        int ParseConfigLine(void *parsed, const char *section, const char *name, const char *value)
         {
-            for (std::size_t i = 0; i != keyNames.size(); ++i)
-            {
-                if (strcmp(keyNames[i], text) == 0)
-                {
-                    return static_cast<ControllerButton>(i);
-                }
-            }
-            return NONE;
+            AMS_UNUSED(section);
+
+            return ParseConfigValue(parsed != NULL ? static_cast<ParsedConfig *>(parsed) : &tempParsed, name, value) ? 1 : 0;
         }
 
-        RGBAColor DecodeColorValue(const char *value)
+        void AddParsedDevice()
         {
-            RGBAColor color{255};
-            uint8_t counter = 0;
-            int charIndex = 0;
-            while (value[charIndex] != '\0')
+            if (tempDeviceSection[0] == '\0')
+                return;
+
+            // A section without a driver can still hold a profile for a device sys-con already knows
+            bool hasProfile = tempParsed.overrides.keyMask != 0 || tempParsed.overrides.buttonMask != 0;
+            bool hasDevice = tempDevice.type != CONTROLLER_UNDEFINED;
+
+            if (tempDevice.id.vendor_id == 0 || (!hasDevice && !hasProfile) || (hasDevice && userDeviceCount == MaxUserDevices) ||
+                (hasProfile && (tempDevice.id.product_id == 0 || deviceProfileCount == MaxDeviceProfiles)))
             {
-                if (charIndex == 0)
-                    color.values[counter++] = atoi(value + charIndex++);
-                if (value[charIndex++] == ',')
-                {
-                    color.values[counter++] = atoi(value + charIndex);
-                    if (counter == 4)
-                        break;
-                }
+                LOG_WARNING("Skipping device [%s] (vid: 0x%04x, pid: 0x%04x)", tempDeviceSection, tempDevice.id.vendor_id, tempDevice.id.product_id);
+                return;
             }
-            return color;
+
+            if (hasDevice)
+                configCache.devices[userDeviceCount++] = tempDevice;
+
+            if (hasProfile)
+                configCache.profiles[deviceProfileCount++] = DeviceProfile{tempDevice.id.vendor_id, tempDevice.id.product_id, tempParsed.overrides};
         }
 
-        int ParseConfigLine(void *dummy, const char *section, const char *name, const char *value)
+        int ParseDeviceLine(void *dummy, const char *section, const char *name, const char *value)
         {
             AMS_UNUSED(dummy);
-            AMS_UNUSED(section);
 
-            if (strncmp(name, "KEY_", 4) == 0)
-            {
-                ControllerButton button = StringToKey(name + 4);
-                ControllerButton buttonValue = StringToKey(value);
-                if (button >= 2)
-                {
-                    tempConfig.buttons[button - 2] = buttonValue;
-                    return 1;
-                }
-            }
-            else if (strcmp(name, "left_stick_deadzone") == 0)
-            {
-                tempConfig.stickDeadzonePercent[0] = atoi(value);
-                return 1;
-            }
-            else if (strcmp(name, "right_stick_deadzone") == 0)
+            if (strcmp(section, tempDeviceSection) != 0)
             {
-                tempConfig.stickDeadzonePercent[1] = atoi(value);
-                return 1;
-            }
-            else if (strcmp(name, "left_stick_rotation") == 0)
-            {
-                tempConfig.stickRotationDegrees[0] = atoi(value);
-                return 1;
+                AddParsedDevice();
+                tempDevice = DeviceEntry{};
+                tempParsed.overrides = ConfigOverrides{};
+                ams::util::TSNPrintf(tempDeviceSection, sizeof(tempDeviceSection), "%s", section);
             }
-            else if (strcmp(name, "right_stick_rotation") == 0)
-            {
-                tempConfig.stickRotationDegrees[1] = atoi(value);
+
+            // Anything else is a config key of the device's profile
+            if (ParseDeviceValue(&tempDevice, name, value))
                 return 1;
-            }
-            else if (strcmp(name, "left_trigger_deadzone") == 0)
+            return ParseConfigLine(NULL, section, name, value);
+        }
+
+        // Parsed into the config cache, ApplyConfigFile builds the device database's index and the profiles from there
+        void ParseDeviceDatabase()
+        {
+            tempDevice = DeviceEntry{};
+            tempDeviceSection[0] = '\0';
+            userDeviceCount = 0;
+            deviceProfileCount = 0;
+
+            // A missing file just means there are no user devices
+            if (ini_parse(DEVICESCONFIG, ParseDeviceLine, NULL) >= 0)
+                AddParsedDevice();
+            configCache.deviceCount = userDeviceCount;
+            configCache.profileCount = deviceProfileCount;
+
+            if (userDeviceCount != 0 || deviceProfileCount != 0)
+                LOG_INFO("Loaded %u user devices and %u device profiles", userDeviceCount, deviceProfileCount);
+        }
+
+        ams::Result ReadFromConfig(const char *path, ParsedConfig *parsed = &tempParsed)
+        {
+            parsed->overrides = ConfigOverrides{};
+            parsed->ledColor = RGBAColor{};
+            R_RETURN(ini_parse(path, ParseConfigLine, parsed));
+        }
+    } // namespace
+
+    void LoadGlobalConfig(const GlobalConfig &config)
+    {
+        config::globalConfig = config;
+        SwitchHDLAggregator::SetSubmitInterval(config.hdlSubmitIntervalMs * 1'000'000ULL);
+        logLevelThreshold.store(config.logLevel, std::memory_order_relaxed);
+        SwitchTrace::SetEnabled(config.traceEvents);
+    }
+
+    namespace
+    {
+        constexpr const char *configPaths[ConfigFile_Count] = {
+            GLOBALCONFIG,
+            XBOXCONFIG,
+            XBOX360CONFIG,
+            XBOXONECONFIG,
+            DUALSHOCK3CONFIG,
+            DUALSHOCK4CONFIG,
+            DEVICESCONFIG,
+        };
+
+        constexpr u32 DriverConfigFiles = BIT(ConfigFile_Xbox) | BIT(ConfigFile_Xbox360) | BIT(ConfigFile_XboxOne) | BIT(ConfigFile_Dualshock3) | BIT(ConfigFile_Dualshock4);
+
+        // Guards the parse buffers above as well, the init threads may need a config loaded while the config thread reloads another
+        ams::os::Mutex configMutex(false);
+        // Driver configs that changed while no controller was using them
+        u32 staleConfigs = 0;
+        std::array<u8, ConfigFile_Count> configUsers{};
+        // The timestamps seen by the last CheckForFileChanges
+        u64 configLastModified[ConfigFile_Count];
+
+        // What controllers with a profile point to, resolved against their driver's config when they connect.
+        // A slot isn't reused while a controller still points to it, even if its profile was removed from devices.ini
+        struct ProfileSlot
+        {
+            DeviceProfile profile;
+            SharedControllerConfig resolved;
+            ConfigFile family;
+            u8 users;
+            bool present;
+        };
+
+        ProfileSlot profileSlots[MaxDeviceProfiles];
+        // Open addressing over vid/pid, holds the index of a present slot or InvalidProfile
+        constexpr u8 InvalidProfile = 0xFF;
+        constexpr size_t ProfileIndexSize = MaxDeviceProfiles * 2;
+        std::array<u8, ProfileIndexSize> profileIndex = [] {
+            std::array<u8, ProfileIndexSize> index;
+            index.fill(InvalidProfile);
+            return index;
+        }();
+
+        constexpr u32 MakeProfileKey(u16 vendorId, u16 productId)
+        {
+            return (static_cast<u32>(vendorId) << 16) | productId;
+        }
+
+        constexpr size_t HashProfileKey(u32 key)
+        {
+            return (key * 2654435761u) % ProfileIndexSize;
+        }
+
+        ProfileSlot *FindProfile(u16 vendorId, u16 productId)
+        {
+            u32 key = MakeProfileKey(vendorId, productId);
+            for (size_t i = HashProfileKey(key); profileIndex[i] != InvalidProfile; i = (i + 1) % ProfileIndexSize)
             {
-                tempConfig.triggerDeadzonePercent[0] = atoi(value);
-                return 1;
+                ProfileSlot &slot = profileSlots[profileIndex[i]];
+                if (MakeProfileKey(slot.profile.vendor_id, slot.profile.product_id) == key)
+                    return &slot;
             }
-            else if (strcmp(name, "right_trigger_deadzone") == 0)
+            return nullptr;
+        }
+
+        void ApplyOverrides(const ConfigOverrides &overrides, ControllerConfig &config)
+        {
+            for (u32 i = 0; i != MAX_CONTROLLER_BUTTONS; ++i)
             {
-                tempConfig.triggerDeadzonePercent[1] = atoi(value);
-                return 1;
+                if (overrides.buttonMask & BIT(i))
+                    config.buttons[i] = overrides.values.buttons[i];
             }
-            else if (strcmp(name, "swap_dpad_and_lstick") == 0)
+
+            for (u32 key = 0; key != 32; ++key)
             {
-                tempConfig.swapDPADandLSTICK = (strcmp(value, "true") ? false : true);
-                return 1;
+                if ((overrides.keyMask & BIT(key)) == 0)
+                    continue;
+
+                switch (key)
+                {
+                    case ConfigKey_LeftStickDeadzone:
+                        config.stickDeadzonePercent[0] = overrides.values.stickDeadzonePercent[0];
+                        break;
+                    case ConfigKey_RightStickDeadzone:
+                        config.stickDeadzonePercent[1] = overrides.values.stickDeadzonePercent[1];
+                        break;
+                    case ConfigKey_LeftStickRotation:
+                        config.stickRotationDegrees[0] = overrides.values.stickRotationDegrees[0];
+                        break;
+                    case ConfigKey_RightStickRotation:
+                        config.stickRotationDegrees[1] = overrides.values.stickRotationDegrees[1];
+                        break;
+                    case ConfigKey_LeftTriggerDeadzone:
+                        config.triggerDeadzonePercent[0] = overrides.values.triggerDeadzonePercent[0];
+                        break;
+                    case ConfigKey_RightTriggerDeadzone:
+                        config.triggerDeadzonePercent[1] = overrides.values.triggerDeadzonePercent[1];
+                        break;
+                    case ConfigKey_SwapDpadAndLstick:
+                        config.swapDPADandLSTICK = overrides.values.swapDPADandLSTICK;
+                        break;
+                    case ConfigKey_ColorBody:
+                        config.bodyColor = overrides.values.bodyColor;
+                        break;
+                    case ConfigKey_ColorButtons:
+                        config.buttonsColor = overrides.values.buttonsColor;
+                        break;
+                    case ConfigKey_ColorLeftGrip:
+                        config.leftGripColor = overrides.values.leftGripColor;
+                        break;
+                    case ConfigKey_ColorRightGrip:
+                        config.rightGripColor = overrides.values.rightGripColor;
+                        break;
+                    default:
+                        // The rest are global or per driver only
+                        break;
+                }
             }
-            else if (strcmp(name, "firmware_path") == 0)
+        }
+
+        // The driver's config, with the active title's profile on top if there is one
+        ControllerConfig GetDriverConfig(ConfigFile file)
+        {
+            ControllerConfig config = configCache.controllers[file];
+            if (activeTitleOverrides != nullptr)
+                ApplyOverrides(*activeTitleOverrides, config);
+            ApplyOverrides(runtimeOverrides[file], config);
+            return config;
+        }
+
+        // The device's keys go over the driver's config, the title's over both
+        void ResolveProfile(ProfileSlot &slot)
+        {
+            ControllerConfig config = configCache.controllers[slot.family];
+            ApplyOverrides(slot.profile.overrides, config);
+            if (activeTitleOverrides != nullptr)
+                ApplyOverrides(*activeTitleOverrides, config);
+            ApplyOverrides(runtimeOverrides[slot.family], config);
+            slot.resolved.Set(config);
+        }
+
+        // Re-resolve the profiles in use after their driver's config changed
+        void RefreshProfiles(ConfigFile family)
+        {
+            for (ProfileSlot &slot : profileSlots)
             {
-                strcpy(firmwarePath, value);
-                return 1;
+                if (slot.users != 0 && slot.family == family)
+                    ResolveProfile(slot);
             }
-            else if (strncmp(name, "color_", 6) == 0)
+        }
+
+        void LoadProfiles()
+        {
+            for (ProfileSlot &slot : profileSlots)
+                slot.present = false;
+            profileIndex.fill(InvalidProfile);
+
+            for (u32 i = 0; i != configCache.profileCount; ++i)
             {
-                if (strcmp(name + 6, "body") == 0)
-                {
-                    tempConfig.bodyColor = DecodeColorValue(value);
-                    return 1;
-                }
-                else if (strcmp(name + 6, "buttons") == 0)
+                const DeviceProfile &profile = configCache.profiles[i];
+                u32 key = MakeProfileKey(profile.vendor_id, profile.product_id);
+
+                // Keep a device in the slot its controllers already point to
+                ProfileSlot *target = nullptr;
+                for (ProfileSlot &slot : profileSlots)
                 {
-                    tempConfig.buttonsColor = DecodeColorValue(value);
-                    return 1;
+                    if ((slot.users != 0 || slot.present) && MakeProfileKey(slot.profile.vendor_id, slot.profile.product_id) == key)
+                        target = &slot;
                 }
-                else if (strcmp(name + 6, "leftGrip") == 0)
+                for (ProfileSlot &slot : profileSlots)
                 {
-                    tempConfig.leftGripColor = DecodeColorValue(value);
-                    return 1;
+                    if (target == nullptr && slot.users == 0 && !slot.present)
+                        target = &slot;
                 }
-                else if (strcmp(name + 6, "rightGrip") == 0)
+                if (target == nullptr)
                 {
-                    tempConfig.rightGripColor = DecodeColorValue(value);
-                    return 1;
+                    LOG_WARNING("No room for the profile of 0x%04x:0x%04x", profile.vendor_id, profile.product_id);
+                    continue;
                 }
-                else if (strcmp(name + 6, "led") == 0)
+
+                // A later section for the same device replaces the earlier one
+                if (!target->present)
                 {
-                    tempColor = DecodeColorValue(value);
-                    return 1;
+                    size_t index = HashProfileKey(key);
+                    while (profileIndex[index] != InvalidProfile)
+                        index = (index + 1) % ProfileIndexSize;
+                    profileIndex[index] = static_cast<u8>(target - profileSlots);
                 }
+
+                target->profile = profile;
+                target->present = true;
+                if (target->users != 0)
+                    ResolveProfile(*target);
             }
+        }
 
-            return 0;
+        ConfigFile GetControllerConfigFile(ControllerType type)
+        {
+            switch (type)
+            {
+                case CONTROLLER_XBOXORIG:
+                    return ConfigFile_Xbox;
+                case CONTROLLER_XBOX360:
+                case CONTROLLER_XBOX360W:
+                    return ConfigFile_Xbox360;
+                case CONTROLLER_XBOXONE:
+                case CONTROLLER_XBOXONEW:
+                    return ConfigFile_XboxOne;
+                case CONTROLLER_DUALSHOCK3:
+                    return ConfigFile_Dualshock3;
+                case CONTROLLER_DUALSHOCK4:
+                    return ConfigFile_Dualshock4;
+                default:
+                    return ConfigFile_Count;
+            }
         }
 
-        ams::Result ReadFromConfig(const char *path)
+        // Hand the cached results of a file to whoever uses them. Must be called with configMutex held
+        void ApplyConfigFile(ConfigFile file)
         {
-            tempConfig = ControllerConfig{};
-            R_RETURN(ini_parse(path, ParseConfigLine, NULL));
+            if (DriverConfigFiles & BIT(file))
+                RefreshProfiles(file);
+
+            ControllerConfig config = GetDriverConfig(file);
+            switch (file)
+            {
+                case ConfigFile_Global:
+                    LoadGlobalConfig(configCache.global);
+                    break;
+                case ConfigFile_Xbox:
+                    XboxController::LoadConfig(&config);
+                    break;
+                case ConfigFile_Xbox360:
+                    Xbox360Controller::LoadConfig(&config);
+                    Xbox360WirelessController::LoadConfig(&config);
+                    break;
+                case ConfigFile_XboxOne:
+                    XboxOneController::LoadConfig(&config);
+                    break;
+                case ConfigFile_Dualshock3:
+                    Dualshock3Controller::LoadConfig(&config);
+                    break;
+                case ConfigFile_Dualshock4:
+                    Dualshock4Controller::LoadConfig(&config, (runtimeOverrides[file].keyMask & BIT(ConfigKey_ColorLed)) ? runtimeLedColor : configCache.ledColor);
+                    break;
+                case ConfigFile_Devices:
+                    BeginUserDevices();
+                    for (u32 i = 0; i != configCache.deviceCount; ++i)
+                        AddUserDevice(configCache.devices[i]);
+                    CommitUserDevices();
+                    LoadProfiles();
+                    break;
+                default:
+                    break;
+            }
         }
 
-        void ConfigChangedCheckThreadFunc(void *)
+        // Swap every driver config and profile in use for one with the active title's profile. Only the parsed configs are used,
+        // the controllers pick the new ones up on their next frame. Must be called with configMutex held
+        void ApplyActiveTitle(bool profilesChanged)
         {
-            WriteToLog("Starting config check thread!");
-            do
+            const TitleProfile *first = titleProfiles;
+            const TitleProfile *last = titleProfiles + titleProfileCount;
+            const TitleProfile *title = std::lower_bound(first, last, activeProgramId, [](const TitleProfile &profile, u64 programId) {
+                return profile.programId < programId;
+            });
+
+            const ConfigOverrides *overrides = (title != last && title->programId == activeProgramId) ? &title->overrides : nullptr;
+            if (overrides == activeTitleOverrides && !profilesChanged)
+                return;
+
+            activeTitleOverrides = overrides;
+            for (u32 i = 0; i != ConfigFile_Count; ++i)
             {
-                if (R_SUCCEEDED(waitSingle(filecheckTimerWaiter, UINT64_MAX)))
-                {
-                    if (config::CheckForFileChanges())
-                    {
-                        WriteToLog("File check succeeded! Loading configs...");
-                        config::LoadAllConfigs();
-                    }
-                }
-            } while (is_config_changed_check_thread_running);
+                if ((DriverConfigFiles & BIT(i)) && (configCache.validFiles & BIT(i)))
+                    ApplyConfigFile(static_cast<ConfigFile>(i));
+            }
+
+            if (overrides != nullptr)
+                LOG_INFO("Using the profile of title %016lX", activeProgramId);
+        }
+
+        // Must be called with configMutex held
+        void LoadConfigFile(ConfigFile file)
+        {
+            configCache.timestamps[file] = configLastModified[file];
+            configCache.validFiles &= ~BIT(file);
+            configCacheDirty = true;
+            runtimeOverrides[file] = ConfigOverrides{};
+
+            if (file == ConfigFile_Devices)
+            {
+                ParseDeviceDatabase();
+                configCache.validFiles |= BIT(file);
+                ApplyConfigFile(file);
+                return;
+            }
+
+            tempParsed.global = GlobalConfig{};
+            if (R_FAILED(ReadFromConfig(configPaths[file])))
+            {
+                LOG_ERROR("Failed to read from %s!", configPaths[file]);
+                return;
+            }
+
+            if (file == ConfigFile_Global)
+                configCache.global = tempParsed.global;
+            else
+                configCache.controllers[file] = tempParsed.overrides.values;
+
+            if (file == ConfigFile_Dualshock4)
+                configCache.ledColor = tempParsed.ledColor;
+
+            configCache.validFiles |= BIT(file);
+            ApplyConfigFile(file);
+        }
+
+        // Returns a BIT(ConfigFile) mask of the files that were applied from the cache. Must be called with configMutex held
+        u32 LoadConfigCache()
+        {
+            ams::fs::FileHandle cacheFile;
+            if (R_FAILED(ams::fs::OpenFile(&cacheFile, ConfigCachePath, ams::fs::OpenMode_Read)))
+                return 0;
+
+            s64 cacheSize = 0;
+            bool readSucceeded = R_SUCCEEDED(ams::fs::GetFileSize(&cacheSize, cacheFile)) && cacheSize == sizeof(ConfigCache) &&
+                                 R_SUCCEEDED(ams::fs::ReadFile(cacheFile, 0, &configCache, sizeof(ConfigCache)));
+            ams::fs::CloseFile(cacheFile);
+
+            if (!readSucceeded || configCache.magic != ConfigCacheMagic || configCache.version != ConfigCacheVersion ||
+                configCache.deviceCount > MaxUserDevices || configCache.profileCount > MaxDeviceProfiles)
+            {
+                configCache = ConfigCache{ConfigCacheMagic, ConfigCacheVersion};
+                return 0;
+            }
+
+            u32 cachedFiles = 0;
+            for (u32 i = 0; i != ConfigFile_Count; ++i)
+            {
+                if (configCache.timestamps[i] != configLastModified[i])
+                    continue;
+
+                if (configCache.validFiles & BIT(i))
+                    ApplyConfigFile(static_cast<ConfigFile>(i));
+                cachedFiles |= BIT(i);
+            }
+            return cachedFiles;
+        }
+
+        void FlushConfigCache()
+        {
+            {
+                std::scoped_lock lock(configMutex);
+                if (!configCacheDirty)
+                    return;
+                configCacheCopy = configCache;
+                configCacheDirty = false;
+            }
+
+            bool hasFile;
+            ams::Result rc = ams::fs::HasFile(&hasFile, ConfigCachePath);
+            if (R_SUCCEEDED(rc) && !hasFile)
+                rc = ams::fs::CreateFile(ConfigCachePath, sizeof(ConfigCache));
+
+            ams::fs::FileHandle cacheFile;
+            if (R_SUCCEEDED(rc))
+                rc = ams::fs::OpenFile(&cacheFile, ConfigCachePath, ams::fs::OpenMode_Write);
+
+            if (R_SUCCEEDED(rc))
+            {
+                rc = ams::fs::SetFileSize(cacheFile, sizeof(ConfigCache));
+                if (R_SUCCEEDED(rc))
+                    rc = ams::fs::WriteFile(cacheFile, 0, &configCacheCopy, sizeof(ConfigCache), ams::fs::WriteOption::Flush);
+                ams::fs::CloseFile(cacheFile);
+            }
+
+            if (R_FAILED(rc))
+                LOG_ERROR("Failed to write the config cache: 0x%x", rc.GetValue());
         }
     } // namespace
 
-    void LoadGlobalConfig(const GlobalConfig &config)
+    void LoadAllConfigs()
     {
-        config::globalConfig = config;
+        std::scoped_lock lock(configMutex);
+        for (u32 i = 0; i != ConfigFile_Count; ++i)
+            LoadConfigFile(static_cast<ConfigFile>(i));
+        staleConfigs = 0;
     }
 
-    void LoadAllConfigs()
+    void LoadConfigsFromCache()
     {
-        if (R_SUCCEEDED(ReadFromConfig(GLOBALCONFIG)))
+        std::scoped_lock lock(configMutex);
+        u32 cachedFiles = LoadConfigCache();
+        for (u32 i = 0; i != ConfigFile_Count; ++i)
         {
-            LoadGlobalConfig(tempGlobalConfig);
+            if ((cachedFiles & BIT(i)) == 0)
+                LoadConfigFile(static_cast<ConfigFile>(i));
         }
-        else
-            WriteToLog("Failed to read from global config!");
+        staleConfigs = 0;
 
-        if (R_SUCCEEDED(ReadFromConfig(XBOXCONFIG)))
+        if (cachedFiles != 0)
+            LOG_INFO("Loaded %d of %d config files from the cache", std::popcount(cachedFiles), static_cast<int>(ConfigFile_Count));
+    }
+
+    void LoadConfigs(u32 files)
+    {
+        std::scoped_lock lock(configMutex);
+        for (u32 i = 0; i != ConfigFile_Count; ++i)
         {
-            XboxController::LoadConfig(&tempConfig);
+            if ((files & BIT(i)) == 0)
+                continue;
+
+            // Nothing would pick it up right now, so the parse waits until a controller connects
+            if ((DriverConfigFiles & BIT(i)) && configUsers[i] == 0)
+            {
+                staleConfigs |= BIT(i);
+                continue;
+            }
+
+            LoadConfigFile(static_cast<ConfigFile>(i));
+            staleConfigs &= ~BIT(i);
         }
-        else
-            WriteToLog("Failed to read from xbox orig config!");
+    }
 
-        if (R_SUCCEEDED(ReadFromConfig(XBOXONECONFIG)))
-            XboxOneController::LoadConfig(&tempConfig);
-        else
-            WriteToLog("Failed to read from xbox one config!");
+    const SharedControllerConfig *AcquireControllerConfig(ControllerType type, u16 vendorId, u16 productId)
+    {
+        ConfigFile file = GetControllerConfigFile(type);
+        if (file == ConfigFile_Count)
+            return nullptr;
 
-        if (R_SUCCEEDED(ReadFromConfig(XBOX360CONFIG)))
+        std::scoped_lock lock(configMutex);
+        ++configUsers[file];
+        if (staleConfigs & BIT(file))
         {
-            Xbox360Controller::LoadConfig(&tempConfig);
-            Xbox360WirelessController::LoadConfig(&tempConfig);
+            LoadConfigFile(file);
+            staleConfigs &= ~BIT(file);
         }
-        else
-            WriteToLog("Failed to read from xbox 360 config!");
-
-        if (R_SUCCEEDED(ReadFromConfig(DUALSHOCK3CONFIG)))
-            Dualshock3Controller::LoadConfig(&tempConfig);
-        else
-            WriteToLog("Failed to read from dualshock 3 config!");
-
-        if (R_SUCCEEDED(ReadFromConfig(DUALSHOCK4CONFIG)))
-            Dualshock4Controller::LoadConfig(&tempConfig, tempColor);
-        else
-            WriteToLog("Failed to read from dualshock 4 config!");
+
+        ProfileSlot *slot = FindProfile(vendorId, productId);
+        if (slot == nullptr)
+            return nullptr;
+
+        ++slot->users;
+        slot->family = file;
+        ResolveProfile(*slot);
+        LOG_INFO("Using the profile of 0x%04x:0x%04x", vendorId, productId);
+        return &slot->resolved;
     }
 
-    bool CheckForFileChanges()
+    void ReleaseControllerConfig(ControllerType type, const SharedControllerConfig *config)
     {
-        static u64 globalConfigLastModified;
-        static u64 xboxConfigLastModified;
-        static u64 xbox360ConfigLastModified;
-        static u64 xboxOneConfigLastModified;
-        static u64 dualshock3ConfigLastModified;
-        static u64 dualshock4ConfigLastModified;
+        ConfigFile file = GetControllerConfigFile(type);
+        if (file == ConfigFile_Count)
+            return;
+
+        std::scoped_lock lock(configMutex);
+        if (configUsers[file] != 0)
+            --configUsers[file];
+
+        for (ProfileSlot &slot : profileSlots)
+        {
+            if (config == &slot.resolved && slot.users != 0)
+                --slot.users;
+        }
+    }
 
+    u32 CheckForFileChanges()
+    {
         // Maybe this should be called only once when initializing?
         // I left it here in case this would cause issues when ejecting the SD card
         FsFileSystem *fs = fsdevGetDeviceFileSystem("sdmc");
 
         if (fs == nullptr)
-            return false;
+            return 0;
 
-        bool filesChanged = false;
+        u32 filesChanged = 0;
         FsTimeStampRaw timestamp;
 
-        if (R_SUCCEEDED(fsFsGetFileTimeStampRaw(fs, GLOBALCONFIG, &timestamp)))
-            if (globalConfigLastModified != timestamp.modified)
-            {
-                globalConfigLastModified = timestamp.modified;
-                filesChanged = true;
-            }
+        for (u32 i = 0; i != ConfigFile_Count; ++i)
+        {
+            if (R_SUCCEEDED(fsFsGetFileTimeStampRaw(fs, configPaths[i], &timestamp)))
+                if (configLastModified[i] != timestamp.modified)
+                {
+                    configLastModified[i] = timestamp.modified;
+                    filesChanged |= BIT(i);
+                }
+        }
+        return filesChanged;
+    }
 
-        if (R_SUCCEEDED(fsFsGetFileTimeStampRaw(fs, XBOXCONFIG, &timestamp)))
-            if (xboxConfigLastModified != timestamp.modified)
-            {
-                xboxConfigLastModified = timestamp.modified;
-                filesChanged = true;
-            }
+    namespace
+    {
+        // Only touched by the config thread
+        FsDirectoryEntry configDirEntries[8];
+
+        // A single listing of a config folder. Saving a file almost always changes its size, or replaces it,
+        // which is enough to tell whether the files in a folder without kept timestamps are worth reading again
+        u64 GetConfigDirectorySignature(const char *path)
+        {
+            FsFileSystem *fs = fsdevGetDeviceFileSystem("sdmc");
+            if (fs == nullptr)
+                return 0;
+
+            FsDir dir;
+            if (R_FAILED(fsFsOpenDirectory(fs, path, FsDirOpenMode_ReadFiles, &dir)))
+                return 0;
+
+            u64 signature = 14695981039346656037ULL;
+            auto hash = [&signature](const void *data, size_t size) {
+                for (size_t i = 0; i != size; ++i)
+                {
+                    signature ^= static_cast<const u8 *>(data)[i];
+                    signature *= 1099511628211ULL;
+                }
+            };
 
-        if (R_SUCCEEDED(fsFsGetFileTimeStampRaw(fs, XBOX360CONFIG, &timestamp)))
-            if (xbox360ConfigLastModified != timestamp.modified)
+            s64 count = 0;
+            while (R_SUCCEEDED(fsDirRead(&dir, &count, sizeof(configDirEntries) / sizeof(FsDirectoryEntry), configDirEntries)) && count > 0)
             {
-                xbox360ConfigLastModified = timestamp.modified;
-                filesChanged = true;
+                for (s64 i = 0; i != count; ++i)
+                {
+                    // The log and the config cache live in the same folder and change on their own
+                    size_t nameLength = strnlen(configDirEntries[i].name, sizeof(configDirEntries[i].name));
+                    if (nameLength < 4 || strcmp(configDirEntries[i].name + nameLength - 4, ".ini") != 0)
+                        continue;
+
+                    hash(configDirEntries[i].name, nameLength);
+                    hash(&configDirEntries[i].file_size, sizeof(configDirEntries[i].file_size));
+                }
             }
 
-        if (R_SUCCEEDED(fsFsGetFileTimeStampRaw(fs, XBOXONECONFIG, &timestamp)))
-            if (xboxOneConfigLastModified != timestamp.modified)
+            fsDirClose(&dir);
+            return signature;
+        }
+
+        // Parsed ahead of time, so switching titles never has to touch the SD card. The SD card is read into the spare table,
+        // configMutex is only held to swap it in
+        void LoadTitleProfiles()
+        {
+            TitleProfile *staged = titleProfiles == titleProfileTables[0] ? titleProfileTables[1] : titleProfileTables[0];
+            u32 stagedCount = 0;
+
+            FsFileSystem *fs = fsdevGetDeviceFileSystem("sdmc");
+            FsDir dir;
+            // A missing folder just means there are no title profiles
+            bool hasDir = fs != nullptr && R_SUCCEEDED(fsFsOpenDirectory(fs, TITLESCONFIG_PATH, FsDirOpenMode_ReadFiles, &dir));
+
+            s64 count = 0;
+            while (hasDir && R_SUCCEEDED(fsDirRead(&dir, &count, sizeof(configDirEntries) / sizeof(FsDirectoryEntry), configDirEntries)) && count > 0)
             {
-                xboxOneConfigLastModified = timestamp.modified;
-                filesChanged = true;
+                for (s64 i = 0; i != count; ++i)
+                {
+                    // <program id>.ini, 16 hex digits
+                    const char *name = configDirEntries[i].name;
+                    char *end;
+                    u64 programId = strtoull(name, &end, 16);
+                    if (end != name + 16 || strcmp(end, ".ini") != 0)
+                        continue;
+
+                    if (stagedCount == MaxTitleProfiles)
+                    {
+                        LOG_WARNING("No room for the profile of title %016lX", programId);
+                        continue;
+                    }
+
+                    char path[64];
+                    ams::util::TSNPrintf(path, sizeof(path), TITLESCONFIG_PATH "%s", name);
+                    if (R_FAILED(ReadFromConfig(path, &titleParsed)))
+                    {
+                        LOG_ERROR("Failed to read from %s!", path);
+                        continue;
+                    }
+                    staged[stagedCount++] = TitleProfile{programId, titleParsed.overrides};
+                }
             }
 
-        if (R_SUCCEEDED(fsFsGetFileTimeStampRaw(fs, DUALSHOCK3CONFIG, &timestamp)))
-            if (dualshock3ConfigLastModified != timestamp.modified)
+            if (hasDir)
+                fsDirClose(&dir);
+
+            std::sort(staged, staged + stagedCount, [](const TitleProfile &a, const TitleProfile &b) {
+                return a.programId < b.programId;
+            });
+
+            std::scoped_lock lock(configMutex);
+            titleProfiles = staged;
+            titleProfileCount = stagedCount;
+
+            // The profiles moved to the other table, the active one has to be looked up again
+            ApplyActiveTitle(true);
+
+            if (titleProfileCount != 0)
+                LOG_INFO("Loaded %u title profiles", titleProfileCount);
+        }
+
+        void ConfigChangedCheckThreadFunc(void *)
+        {
+            static u64 lastTitlesSignature = GetConfigDirectorySignature(TITLESCONFIG_PATH);
+
+            bool reloadRequested = g_config_changed_check_thread.Wait(waiterForUEvent(&g_reloadRequestEvent), checkIntervalNs);
+            if (g_config_changed_check_thread.IsStopRequested())
+                return;
+
+            // Title profiles have no timestamps kept, so an edit that kept the file's size is only seen by reading them again
+            // every now and then
+            bool fullCheckDue = false;
+            if (checkIntervalNs == MaxCheckIntervalNs && ++steadyWakeCount == FullCheckEveryWakes)
             {
-                dualshock3ConfigLastModified = timestamp.modified;
-                filesChanged = true;
+                fullCheckDue = true;
+                steadyWakeCount = 0;
             }
 
-        if (R_SUCCEEDED(fsFsGetFileTimeStampRaw(fs, DUALSHOCK4CONFIG, &timestamp)))
-            if (dualshock4ConfigLastModified != timestamp.modified)
+            u64 titlesSignature = GetConfigDirectorySignature(TITLESCONFIG_PATH);
+            if (reloadRequested || fullCheckDue || titlesSignature != lastTitlesSignature)
+                LoadTitleProfiles();
+            lastTitlesSignature = titlesSignature;
+
+            // The timestamps catch every edit of the config files, even one that kept the file's size
+            u32 changedFiles = config::CheckForFileChanges();
+
+            // A requested reload goes through every file, even the ones that look the same
+            if (reloadRequested)
+                changedFiles = BIT(ConfigFile_Count) - 1;
+
+            if (changedFiles != 0)
             {
-                dualshock4ConfigLastModified = timestamp.modified;
-                filesChanged = true;
+                LOG_INFO("File check succeeded! Loading configs...");
+                config::LoadConfigs(changedFiles);
+                checkIntervalNs = MinCheckIntervalNs;
+                steadyWakeCount = 0;
             }
-        return filesChanged;
+            else
+                checkIntervalNs = std::min(checkIntervalNs * 2, MaxCheckIntervalNs);
+
+            // Also picks up the driver configs that were only parsed once a controller needed them
+            FlushConfigCache();
+        }
+    } // namespace
+
+    void RequestReload()
+    {
+        // Nobody would pick the request up while polling is disabled, so the reload happens right here instead
+        if (!g_config_changed_check_thread.IsRunning())
+        {
+            LoadTitleProfiles();
+            config::CheckForFileChanges();
+            config::LoadConfigs(BIT(ConfigFile_Count) - 1);
+            FlushConfigCache();
+            return;
+        }
+
+        ueventSignal(&g_reloadRequestEvent);
+    }
+
+    ams::Result SetConfigValue(ConfigFile file, const char *name, const char *value)
+    {
+        // devices.ini has no values that make sense to change on their own
+        R_UNLESS(file < ConfigFile_Devices, ResultUnknownConfigFile());
+
+        std::scoped_lock lock(configMutex);
+        if (file == ConfigFile_Global)
+        {
+            tempParsed.global = globalConfig;
+            R_UNLESS(ParseConfigLine(NULL, "", name, value) != 0, ResultInvalidConfigValue());
+
+            LoadGlobalConfig(tempParsed.global);
+            R_SUCCEED();
+        }
+
+        ConfigOverrides &overrides = runtimeOverrides[file];
+        tempParsed.overrides = overrides;
+        tempParsed.ledColor = runtimeLedColor;
+        R_UNLESS(ParseConfigLine(NULL, "", name, value) != 0, ResultInvalidConfigValue());
+        // Only the Dualshock 4 has a light bar, anywhere else the key would be taken without doing anything
+        R_UNLESS(file == ConfigFile_Dualshock4 || (tempParsed.overrides.keyMask & BIT(ConfigKey_ColorLed)) == 0, ResultInvalidConfigValue());
+
+        overrides = tempParsed.overrides;
+        runtimeLedColor = tempParsed.ledColor;
+        ApplyConfigFile(file);
+        R_SUCCEED();
+    }
+
+    void SetActiveTitle(u64 programId)
+    {
+        std::scoped_lock lock(configMutex);
+        activeProgramId = programId;
+        ApplyActiveTitle(false);
     }
 
     ams::Result Initialize()
     {
-        DiscardOldLogs();
-        config::LoadAllConfigs();
+        // The timestamps have to be known before the cache can be checked against them
         config::CheckForFileChanges();
-        utimerCreate(&filecheckTimer, 1e+9L, TimerType_Repeating);
+        config::LoadConfigsFromCache();
+        FlushConfigCache();
+        LoadTitleProfiles();
+        ueventCreate(&g_reloadRequestEvent, true);
         R_RETURN(Enable());
     }
 
@@ -318,23 +897,20 @@ namespace syscon::config
 
     ams::Result Enable()
     {
-        if (filecheckTimer.started)
-            R_RETURN(1);
+        // Already running is what the caller asked for
+        if (g_config_changed_check_thread.IsRunning())
+            R_SUCCEED();
 
-        utimerStart(&filecheckTimer);
-        is_config_changed_check_thread_running = true;
-        R_TRY(threadCreate(&g_config_changed_check_thread, &ConfigChangedCheckThreadFunc, nullptr, config_thread_stack, sizeof(config_thread_stack), 0x3E, -2));
-        R_TRY(threadStart(&g_config_changed_check_thread));
+        checkIntervalNs = MinCheckIntervalNs;
+        steadyWakeCount = 0;
+        LOG_DEBUG("Starting config check thread!");
+        R_TRY(g_config_changed_check_thread.Start(&ConfigChangedCheckThreadFunc, nullptr, config_thread_stack, sizeof(config_thread_stack), 0x3E));
 
         R_SUCCEED();
     }
 
     void Disable()
     {
-        is_config_changed_check_thread_running = false;
-        utimerStop(&filecheckTimer);
-        svcCancelSynchronization(g_config_changed_check_thread.handle);
-        threadWaitForExit(&g_config_changed_check_thread);
-        threadClose(&g_config_changed_check_thread);
+        g_config_changed_check_thread.Join();
     }
 } // namespace syscon::config
\ No newline at end of file
@@ -1,5 +1,7 @@
 #pragma once
 #include "ControllerTypes.h"
+#include "ControllerConfig.h"
+#include "log.h"
 #include <stratosphere.hpp>
 
 #define CONFIG_PATH "/config/sys-con/"
@@ -10,18 +12,58 @@
 #define XBOXONECONFIG    CONFIG_PATH "config_xboxone.ini"
 #define DUALSHOCK3CONFIG CONFIG_PATH "config_dualshock3.ini"
 #define DUALSHOCK4CONFIG CONFIG_PATH "config_dualshock4.ini"
+#define DEVICESCONFIG    CONFIG_PATH "devices.ini"
+#define TITLESCONFIG_PATH CONFIG_PATH "titles/"
 
 namespace syscon::config
 {
     struct GlobalConfig
     {
+        // How often the HDL states of all controllers are handed to HID, in milliseconds
+        uint8_t hdlSubmitIntervalMs{5};
+        // Messages below this level are left out of the log
+        LogLevel logLevel{LogLevel_Info};
+        // Record the binary event trace to trace.bin
+        bool traceEvents{false};
     };
 
     inline GlobalConfig globalConfig{};
 
+    enum ConfigFile : uint8_t
+    {
+        ConfigFile_Global,
+        ConfigFile_Xbox,
+        ConfigFile_Xbox360,
+        ConfigFile_XboxOne,
+        ConfigFile_Dualshock3,
+        ConfigFile_Dualshock4,
+        ConfigFile_Devices,
+        ConfigFile_Count,
+    };
+
     void LoadGlobalConfig(const GlobalConfig &config);
     void LoadAllConfigs();
-    bool CheckForFileChanges();
+    // Like LoadAllConfigs, but files that haven't changed since the last boot are taken from the config cache instead of being parsed
+    void LoadConfigsFromCache();
+    // Reload the files whose BIT(ConfigFile) is set. Driver configs no controller is using are left for AcquireControllerConfig
+    void LoadConfigs(u32 files);
+    // Returns a BIT(ConfigFile) mask of the files that changed since the last check
+    u32 CheckForFileChanges();
+    // Have the config thread check every file and reload them right away, instead of waiting for its next check.
+    // While config polling is disabled every file is reloaded before this returns
+    void RequestReload();
+    // Set a single key of a config file in memory only, the same way a line in the file would. It stays until the file is reloaded.
+    // Returns ResultUnknownConfigFile for a file that can't be changed this way and ResultInvalidConfigValue for an unknown key or bad value,
+    // or a key that does nothing in that file (color_led outside of the Dualshock 4 config)
+    ams::Result SetConfigValue(ConfigFile file, const char *name, const char *value);
+    // Switch every controller to the profile of the title in the foreground, if it has one. 0 when no title is running
+    void SetActiveTitle(u64 programId);
+
+    // Called for every controller handler that's created and destroyed, so that the driver config is up to date before it's used.
+    // Returns the config of the device's profile in devices.ini, or nullptr if it uses its driver's config
+    const SharedControllerConfig *AcquireControllerConfig(ControllerType type, u16 vendorId, u16 productId);
+    // config is what the controller ended up using, so a profile can be told apart from the driver's config
+    void ReleaseControllerConfig(ControllerType type, const SharedControllerConfig *config);
 
     ams::Result Initialize();
     void Exit();
@@ -0,0 +1,320 @@
+#include <switch.h>
+#include "config_parser.h"
+#include "log.h"
+#include <cstring>
+#include <cstdlib>
+#include <algorithm>
+#include <array>
+#include <string_view>
+
+namespace syscon::config
+{
+    namespace
+    {
+        constexpr u32 HashName(std::string_view name)
+        {
+            u32 hash = 2166136261u;
+            for (char c : name)
+            {
+                hash ^= static_cast<u8>(c);
+                hash *= 16777619u;
+            }
+            return hash;
+        }
+
+        // Names looked up with one hash and one string comparison. A name goes into the slot of its hash modulo Size,
+        // Size is picked so that no two names of the table share a slot, which IsValid checks at compile time
+        template <typename T, size_t Size>
+        class NameTable
+        {
+        public:
+            template <size_t N>
+            constexpr NameTable(const std::array<std::pair<std::string_view, T>, N> &names)
+            {
+                for (const auto &[name, value] : names)
+                {
+                    Slot &slot = m_slots[HashName(name) % Size];
+                    if (!slot.name.empty())
+                        m_valid = false;
+                    slot = Slot{name, value};
+                }
+            }
+
+            constexpr bool IsValid() const { return m_valid; }
+
+            bool Find(std::string_view name, T *out) const
+            {
+                const Slot &slot = m_slots[HashName(name) % Size];
+                if (slot.name.empty() || slot.name != name)
+                    return false;
+
+                *out = slot.value;
+                return true;
+            }
+
+        private:
+            struct Slot
+            {
+                std::string_view name;
+                T value{};
+            };
+
+            std::array<Slot, Size> m_slots{};
+            bool m_valid{true};
+        };
+
+        constexpr std::array<std::string_view, 22> keyNames{
+            "DEFAULT",
+            "NONE",
+            "FACE_UP",
+            "FACE_RIGHT",
+            "FACE_DOWN",
+            "FACE_LEFT",
+            "LSTICK_CLICK",
+            "RSTICK_CLICK",
+            "LEFT_BUMPER",
+            "RIGHT_BUMPER",
+            "LEFT_TRIGGER",
+            "RIGHT_TRIGGER",
+            "BACK",
+            "START",
+            "DPAD_UP",
+            "DPAD_RIGHT",
+            "DPAD_DOWN",
+            "DPAD_LEFT",
+            "CAPTURE",
+            "HOME",
+            "SYNC",
+            "TOUCHPAD",
+        };
+
+        constexpr auto MakeButtonNames()
+        {
+            std::array<std::pair<std::string_view, ControllerButton>, keyNames.size()> names;
+            for (size_t i = 0; i != keyNames.size(); ++i)
+                names[i] = {keyNames[i], static_cast<ControllerButton>(i)};
+            return names;
+        }
+
+        constexpr NameTable<ControllerButton, 95> buttonTable(MakeButtonNames());
+        static_assert(buttonTable.IsValid(), "Two button names share a slot, pick another table size");
+
+        ControllerButton StringToKey(const char *text)
+        {
+            ControllerButton button;
+            return buttonTable.Find(text, &button) ? button : NONE;
+        }
+
+        constexpr NameTable<ConfigKey, 40> configKeys(std::array<std::pair<std::string_view, ConfigKey>, 16>{{
+            {"left_stick_deadzone", ConfigKey_LeftStickDeadzone},
+            {"right_stick_deadzone", ConfigKey_RightStickDeadzone},
+            {"left_stick_rotation", ConfigKey_LeftStickRotation},
+            {"right_stick_rotation", ConfigKey_RightStickRotation},
+            {"left_trigger_deadzone", ConfigKey_LeftTriggerDeadzone},
+            {"right_trigger_deadzone", ConfigKey_RightTriggerDeadzone},
+            {"swap_dpad_and_lstick", ConfigKey_SwapDpadAndLstick},
+            {"hdl_submit_interval_ms", ConfigKey_HdlSubmitIntervalMs},
+            {"firmware_path", ConfigKey_FirmwarePath},
+            {"color_body", ConfigKey_ColorBody},
+            {"color_buttons", ConfigKey_ColorButtons},
+            {"color_leftGrip", ConfigKey_ColorLeftGrip},
+            {"color_rightGrip", ConfigKey_ColorRightGrip},
+            {"color_led", ConfigKey_ColorLed},
+            {"log_level", ConfigKey_LogLevel},
+            {"trace_events", ConfigKey_TraceEvents},
+        }});
+        static_assert(configKeys.IsValid(), "Two config keys share a slot, pick another table size");
+
+        // HID doesn't look at the states more often than every 5ms, and past 100ms the input is noticeably choppy
+        constexpr int MinHdlSubmitIntervalMs = 1;
+        constexpr int MaxHdlSubmitIntervalMs = 100;
+
+        // Up to four comma separated components, the ones that are left out keep their default
+        RGBAColor DecodeColorValue(const char *value)
+        {
+            RGBAColor color{255};
+            for (uint8_t &component : color.values)
+            {
+                if (*value == '\0')
+                    break;
+
+                component = atoi(value);
+                value = strchr(value, ',');
+                if (value == nullptr)
+                    break;
+                ++value;
+            }
+            return color;
+        }
+
+        constexpr std::array driverNames{
+            std::pair{"xbox360", CONTROLLER_XBOX360},
+            std::pair{"xbox360w", CONTROLLER_XBOX360W},
+            std::pair{"xboxone", CONTROLLER_XBOXONE},
+            std::pair{"dualshock3", CONTROLLER_DUALSHOCK3},
+            std::pair{"dualshock4", CONTROLLER_DUALSHOCK4},
+        };
+
+        constexpr std::array quirkNames{
+            std::pair{"hori_init", DEVICE_QUIRK_XBONE_HORI_INIT},
+            std::pair{"pdp_init", DEVICE_QUIRK_XBONE_PDP_INIT},
+            std::pair{"rumble_init", DEVICE_QUIRK_XBONE_RUMBLE_INIT},
+        };
+
+        ControllerType StringToDriver(const char *text)
+        {
+            for (const auto &[name, type] : driverNames)
+            {
+                if (strcmp(name, text) == 0)
+                    return type;
+            }
+            return CONTROLLER_UNDEFINED;
+        }
+
+        // Quirks are given as a comma separated list, e.g. "hori_init, pdp_init"
+        uint8_t DecodeQuirks(const char *value)
+        {
+            uint8_t quirks = DEVICE_QUIRK_NONE;
+            while (*value != '\0')
+            {
+                while (*value == ' ' || *value == ',')
+                    ++value;
+
+                size_t length = strcspn(value, ", ");
+                for (const auto &[name, quirk] : quirkNames)
+                {
+                    if (length != 0 && strlen(name) == length && strncmp(name, value, length) == 0)
+                        quirks |= quirk;
+                }
+                value += length;
+            }
+            return quirks;
+        }
+
+        enum DeviceKey : u8
+        {
+            DeviceKey_Vid,
+            DeviceKey_Pid,
+            DeviceKey_Interface,
+            DeviceKey_Driver,
+            DeviceKey_Quirks,
+        };
+
+        constexpr NameTable<DeviceKey, 10> deviceKeys(std::array<std::pair<std::string_view, DeviceKey>, 5>{{
+            {"vid", DeviceKey_Vid},
+            {"pid", DeviceKey_Pid},
+            {"interface", DeviceKey_Interface},
+            {"driver", DeviceKey_Driver},
+            {"quirks", DeviceKey_Quirks},
+        }});
+        static_assert(deviceKeys.IsValid(), "Two device keys share a slot, pick another table size");
+    } // namespace
+
+    bool ParseConfigValue(ParsedConfig *parsed, const char *name, const char *value)
+    {
+        if (strncmp(name, "KEY_", 4) == 0)
+        {
+            ControllerButton button = StringToKey(name + 4);
+            ControllerButton buttonValue = StringToKey(value);
+            if (button >= 2)
+            {
+                parsed->overrides.values.buttons[button - 2] = buttonValue;
+                parsed->overrides.buttonMask |= BIT(button - 2);
+                return true;
+            }
+            return false;
+        }
+
+        ConfigKey key;
+        if (!configKeys.Find(name, &key))
+            return false;
+
+        switch (key)
+        {
+            case ConfigKey_LeftStickDeadzone:
+                parsed->overrides.values.stickDeadzonePercent[0] = atoi(value);
+                break;
+            case ConfigKey_RightStickDeadzone:
+                parsed->overrides.values.stickDeadzonePercent[1] = atoi(value);
+                break;
+            case ConfigKey_LeftStickRotation:
+                parsed->overrides.values.stickRotationDegrees[0] = atoi(value);
+                break;
+            case ConfigKey_RightStickRotation:
+                parsed->overrides.values.stickRotationDegrees[1] = atoi(value);
+                break;
+            case ConfigKey_LeftTriggerDeadzone:
+                parsed->overrides.values.triggerDeadzonePercent[0] = atoi(value);
+                break;
+            case ConfigKey_RightTriggerDeadzone:
+                parsed->overrides.values.triggerDeadzonePercent[1] = atoi(value);
+                break;
+            case ConfigKey_SwapDpadAndLstick:
+                parsed->overrides.values.swapDPADandLSTICK = (strcmp(value, "true") ? false : true);
+                break;
+            case ConfigKey_HdlSubmitIntervalMs:
+            {
+                int intervalMs = atoi(value);
+                int clampedMs = std::clamp(intervalMs, MinHdlSubmitIntervalMs, MaxHdlSubmitIntervalMs);
+                if (clampedMs != intervalMs)
+                    LOG_WARNING("hdl_submit_interval_ms = %s is out of range, using %d", value, clampedMs);
+                parsed->global.hdlSubmitIntervalMs = clampedMs;
+                break;
+            }
+            case ConfigKey_FirmwarePath:
+                ams::util::TSNPrintf(parsed->firmwarePath, sizeof(parsed->firmwarePath), "%s", value);
+                break;
+            case ConfigKey_ColorBody:
+                parsed->overrides.values.bodyColor = DecodeColorValue(value);
+                break;
+            case ConfigKey_ColorButtons:
+                parsed->overrides.values.buttonsColor = DecodeColorValue(value);
+                break;
+            case ConfigKey_ColorLeftGrip:
+                parsed->overrides.values.leftGripColor = DecodeColorValue(value);
+                break;
+            case ConfigKey_ColorRightGrip:
+                parsed->overrides.values.rightGripColor = DecodeColorValue(value);
+                break;
+            case ConfigKey_ColorLed:
+                parsed->ledColor = DecodeColorValue(value);
+                break;
+            case ConfigKey_LogLevel:
+                if (!ParseLogLevel(value, &parsed->global.logLevel))
+                    return false;
+                break;
+            case ConfigKey_TraceEvents:
+                parsed->global.traceEvents = (strcmp(value, "true") ? false : true);
+                break;
+        }
+        parsed->overrides.keyMask |= BIT(key);
+        return true;
+    }
+
+    bool ParseDeviceValue(DeviceEntry *device, const char *name, const char *value)
+    {
+        DeviceKey key;
+        if (!deviceKeys.Find(name, &key))
+            return false;
+
+        switch (key)
+        {
+            case DeviceKey_Vid:
+                device->id.vendor_id = strtoul(value, nullptr, 0);
+                break;
+            case DeviceKey_Pid:
+                device->id.product_id = strtoul(value, nullptr, 0);
+                break;
+            case DeviceKey_Interface:
+                device->interface_number = strtoul(value, nullptr, 0);
+                break;
+            case DeviceKey_Driver:
+                device->type = StringToDriver(value);
+                break;
+            case DeviceKey_Quirks:
+                device->quirks = DecodeQuirks(value);
+                break;
+        }
+        return true;
+    }
+} // namespace syscon::config
\ No newline at end of file
@@ -0,0 +1,51 @@
+#pragma once
+#include "config_handler.h"
+#include "ControllerDatabase.h"
+
+// Turns the lines of the config files into values. Kept apart from the rest of the config handling,
+// which needs the SD card and the worker threads, so that it can also be built and fuzzed on the host
+namespace syscon::config
+{
+    enum ConfigKey : u8
+    {
+        ConfigKey_LeftStickDeadzone,
+        ConfigKey_RightStickDeadzone,
+        ConfigKey_LeftStickRotation,
+        ConfigKey_RightStickRotation,
+        ConfigKey_LeftTriggerDeadzone,
+        ConfigKey_RightTriggerDeadzone,
+        ConfigKey_SwapDpadAndLstick,
+        ConfigKey_HdlSubmitIntervalMs,
+        ConfigKey_FirmwarePath,
+        ConfigKey_ColorBody,
+        ConfigKey_ColorButtons,
+        ConfigKey_ColorLeftGrip,
+        ConfigKey_ColorRightGrip,
+        ConfigKey_ColorLed,
+        ConfigKey_LogLevel,
+        ConfigKey_TraceEvents,
+    };
+
+    // What a file or section set, so it can be applied over another config without touching the rest
+    struct ConfigOverrides
+    {
+        u32 keyMask;
+        u32 buttonMask;
+        ControllerConfig values;
+    };
+
+    // Everything a config file can set
+    struct ParsedConfig
+    {
+        ConfigOverrides overrides;
+        GlobalConfig global;
+        RGBAColor ledColor;
+        char firmwarePath[100];
+    };
+
+    // Parse one key of a config file, as handed over by ini_parse. Returns false for an unknown key or a bad value
+    bool ParseConfigValue(ParsedConfig *parsed, const char *name, const char *value);
+
+    // Parse one of the keys that describe a device in its devices.ini section. Returns false if name isn't one of them
+    bool ParseDeviceValue(DeviceEntry *device, const char *name, const char *value);
+} // namespace syscon::config
\ No newline at end of file
@@ -2,6 +2,10 @@
 #include "controller_handler.h"
 #include "SwitchHDLHandler.h"
 #include "SwitchAbstractedPadHandler.h"
+#include "SwitchUSBTransferPool.h"
+#include "config_handler.h"
+#include "usb_module.h"
+#include "results.h"
 #include <algorithm>
 #include <functional>
 
@@ -11,29 +15,91 @@ namespace syscon::controllers
 {
     namespace
     {
-        constexpr size_t MaxControllerHandlersSize = 10;
-        std::vector<std::unique_ptr<SwitchVirtualGamepadHandler>> controllerHandlers;
+        std::vector<HandlerPtr> controllerHandlers;
         bool UseAbstractedPad;
         ams::os::Mutex controllerMutex(false);
+
+        // Every handler, along with its thread stacks, gets a fixed slot reserved at build time,
+        // so the number of handlers that can exist at once doesn't depend on the state of the heap
+        constexpr size_t HandlerStorageSize = std::max(sizeof(SwitchHDLHandler), sizeof(SwitchAbstractedPadHandler));
+        constexpr size_t HandlerStorageAlign = std::max(alignof(SwitchHDLHandler), alignof(SwitchAbstractedPadHandler));
+
+        struct HandlerSlot
+        {
+            alignas(HandlerStorageAlign) u8 storage[HandlerStorageSize];
+        };
+
+        GamepadHandlerStacks handlerStacks[MaxControllerHandlersSize];
+        HandlerSlot handlerSlots[MaxControllerHandlersSize];
+
+        // Every controller keeps a transfer page for its in and out endpoints, and takes one for the length of a control transfer
+        constexpr size_t TransferPagesPerHandler = 3;
+        constexpr size_t TransferPagesSize = MaxControllerHandlersSize * TransferPagesPerHandler;
+        static_assert(TransferPagesSize <= SwitchUSBTransferPool::MaxPages);
+        SwitchUSBTransferPool::Page transferPages[TransferPagesSize];
+
+        // Shared by both handler types, abstracted pads have fewer ids to go around so their count is lowered in Initialize
+        SwitchPadSlotAllocator handlerSlotAllocator(MaxControllerHandlersSize);
+        // Only written by Insert before the handler is added to the list, read with the list locked
+        u32 slotGenerations[MaxControllerHandlersSize];
+
+        size_t GetSlotIndex(const SwitchVirtualGamepadHandler *handler)
+        {
+            return (reinterpret_cast<const u8 *>(handler) - reinterpret_cast<const u8 *>(handlerSlots)) / sizeof(HandlerSlot);
+        }
     } // namespace
 
+    void HandlerDeleter::operator()(SwitchVirtualGamepadHandler *handler) const
+    {
+        size_t index = GetSlotIndex(handler);
+        ControllerType type = handler->GetController()->GetType();
+        const SharedControllerConfig *config = handler->GetController()->GetSharedConfig();
+        handler->~SwitchVirtualGamepadHandler();
+        handlerSlotAllocator.Release(index);
+        config::ReleaseControllerConfig(type, config);
+    }
+
+    u32 GetGeneration(const SwitchVirtualGamepadHandler *handler)
+    {
+        return slotGenerations[GetSlotIndex(handler)];
+    }
+
     bool IsAtControllerLimit()
     {
-        return controllerHandlers.size() >= MaxControllerHandlersSize;
+        return handlerSlotAllocator.IsExhausted();
+    }
+
+    s32 AcquireSlot()
+    {
+        return handlerSlotAllocator.Acquire();
     }
 
-    ams::Result Insert(std::unique_ptr<IController> &&controllerPtr)
+    void ReleaseSlot(s32 slot)
     {
-        std::unique_ptr<SwitchVirtualGamepadHandler> switchHandler;
+        handlerSlotAllocator.Release(slot);
+    }
+
+    ams::Result Insert(std::unique_ptr<IController> &&controllerPtr, s32 slot)
+    {
+        R_UNLESS(slot >= 0 && static_cast<size_t>(slot) < MaxControllerHandlersSize, ResultInvalidArgument());
+
+        // Released again by the handler's deleter. The profile is resolved once here, input frames just follow the pointer
+        IUSBDevice *device = controllerPtr->GetDevice();
+        if (const SharedControllerConfig *profile = config::AcquireControllerConfig(controllerPtr->GetType(), device->GetVendor(), device->GetProduct()))
+            controllerPtr->SetSharedConfig(profile);
+
+        ++slotGenerations[slot];
+
+        HandlerPtr switchHandler;
         if (UseAbstractedPad)
         {
-            switchHandler = std::make_unique<SwitchAbstractedPadHandler>(std::move(controllerPtr));
-            WriteToLog("Inserting controller as abstracted pad");
+            switchHandler.reset(new (handlerSlots[slot].storage) SwitchAbstractedPadHandler(std::move(controllerPtr), &handlerStacks[slot], slot));
+            LOG_DEBUG("Inserting controller as abstracted pad");
         }
         else
         {
-            switchHandler = std::make_unique<SwitchHDLHandler>(std::move(controllerPtr));
-            WriteToLog("Inserting controller as HDLs");
+            switchHandler.reset(new (handlerSlots[slot].storage) SwitchHDLHandler(std::move(controllerPtr), &handlerStacks[slot]));
+            LOG_DEBUG("Inserting controller as HDLs");
         }
 
         R_TRY(switchHandler->Initialize());
@@ -44,7 +110,7 @@ namespace syscon::controllers
         R_SUCCEED();
     }
 
-    std::vector<std::unique_ptr<SwitchVirtualGamepadHandler>> &Get()
+    std::vector<HandlerPtr> &Get()
     {
         return controllerHandlers;
     }
@@ -64,7 +130,13 @@ namespace syscon::controllers
     void Initialize()
     {
         UseAbstractedPad = hosversionBetween(5, 7);
+        if (UseAbstractedPad)
+            handlerSlotAllocator.SetSlotCount(std::min<u32>(MaxControllerHandlersSize, SwitchAbstractedPadHandler::MaxAbstractedPads));
         controllerHandlers.reserve(MaxControllerHandlersSize);
+        SwitchUSBTransferPool::SetPages(transferPages, TransferPagesSize);
+
+        if (!UseAbstractedPad)
+            R_ABORT_UNLESS(SwitchHDLAggregator::Initialize());
     }
 
     void Reset()
@@ -76,5 +148,69 @@ namespace syscon::controllers
     void Exit()
     {
         Reset();
+        SwitchHDLAggregator::Exit();
+    }
+
+    void Suspend()
+    {
+        std::scoped_lock scoped_lock(controllerMutex);
+        for (auto &&handler : controllerHandlers)
+            handler->Suspend();
+    }
+
+    void Resume()
+    {
+        // A device that went away while asleep no longer has its interfaces acquired
+        std::array<s32, usb::MaxAcquiredInterfacesSize> acquiredIds;
+        size_t acquiredCount = 0;
+        bool checkInterfaces = usb::QueryAcquiredInterfaceIds(acquiredIds.data(), acquiredIds.size(), &acquiredCount);
+
+        // Resuming a handler paces its USB writes, so the handlers are taken out of the list to be resumed without the lock.
+        // Discovery is paused until they are back, their slots stay taken so it doesn't go past the limit afterwards either.
+        // Handlers that weren't suspended are still running and stay where they are
+        std::array<HandlerPtr, MaxControllerHandlersSize> resuming;
+        size_t resumingCount = 0;
+        {
+            std::scoped_lock scoped_lock(controllerMutex);
+            for (auto it = controllerHandlers.begin(); it != controllerHandlers.end();)
+            {
+                if (!(*it)->IsSuspended())
+                {
+                    ++it;
+                    continue;
+                }
+
+                resuming[resumingCount++] = std::move(*it);
+                it = controllerHandlers.erase(it);
+            }
+        }
+
+        for (size_t i = 0; i != resumingCount; ++i)
+        {
+            HandlerPtr &handler = resuming[i];
+            bool present = std::all_of(handler->GetInterfaceIds(), handler->GetInterfaceIds() + handler->GetInterfaceIdCount(), [&](s32 id) {
+                return !checkInterfaces || std::binary_search(acquiredIds.begin(), acquiredIds.begin() + acquiredCount, id);
+            });
+
+            if (present)
+            {
+                ams::Result res = handler->Resume();
+                if (R_SUCCEEDED(res))
+                    continue;
+                LOG_ERROR("Failed to resume controller: 0x%x", res.GetValue());
+            }
+            else
+                LOG_WARNING("Controller went away while asleep");
+
+            // Its device gets picked up by discovery again
+            handler.reset();
+        }
+
+        std::scoped_lock scoped_lock(controllerMutex);
+        for (size_t i = 0; i != resumingCount; ++i)
+        {
+            if (resuming[i])
+                controllerHandlers.push_back(std::move(resuming[i]));
+        }
     }
 } // namespace syscon::controllers
\ No newline at end of file
@@ -2,14 +2,35 @@
 
 #include "ControllerHelpers.h"
 #include "SwitchVirtualGamepadHandler.h"
+#include "SwitchPadSlotAllocator.h"
 #include <stratosphere.hpp>
 
 namespace syscon::controllers
 {
+    constexpr size_t MaxControllerHandlersSize = 10;
+
+    // Handlers live in a statically reserved slab, this destroys them in place and frees up their slot
+    struct HandlerDeleter
+    {
+        void operator()(SwitchVirtualGamepadHandler *handler) const;
+    };
+
+    using HandlerPtr = std::unique_ptr<SwitchVirtualGamepadHandler, HandlerDeleter>;
+
+    // Slots are reused, so a handler pointer alone doesn't say whether it's still the same handler.
+    // The generation of a slot goes up every time a new handler is put into it
+    u32 GetGeneration(const SwitchVirtualGamepadHandler *handler);
+
     bool IsAtControllerLimit();
 
-    ams::Result Insert(std::unique_ptr<IController> &&controllerPtr);
-    std::vector<std::unique_ptr<SwitchVirtualGamepadHandler>> &Get();
+    // A slot is taken before a controller's interfaces are acquired, so no work is spent on one that could never be attached.
+    // Returns SwitchPadSlotAllocator::InvalidSlot if every slot is taken
+    s32 AcquireSlot();
+    void ReleaseSlot(s32 slot);
+
+    // Takes over the slot, it's given back once the handler is gone or if it fails to initialize. Returns ResultInvalidArgument for a slot out of range
+    ams::Result Insert(std::unique_ptr<IController> &&controllerPtr, s32 slot);
+    std::vector<HandlerPtr> &Get();
     ams::os::Mutex &GetScopedLock();
 
     // void Remove(void Remove(bool (*func)(std::unique_ptr<SwitchVirtualGamepadHandler> a)));;
@@ -17,4 +38,8 @@ namespace syscon::controllers
     void Initialize();
     void Reset();
     void Exit();
+
+    // Park every handler while the console sleeps, and bring back the ones whose device is still there after it wakes up
+    void Suspend();
+    void Resume();
 } // namespace syscon::controllers
\ No newline at end of file
@@ -1,84 +1,424 @@
 #include <switch.h>
 #include "log.h"
+#include "config_handler.h"
 #include <sys/stat.h>
 #include <stratosphere.hpp>
+#include <algorithm>
+#include <cstring>
+#include <strings.h>
+#include <atomic>
+#include "SwitchWorkerThread.h"
+#include "SwitchTrace.h"
 
 namespace
 {
 
     constexpr const char LogFilePath[] = "sdmc:" CONFIG_PATH "log.txt";
+    // The log is split into segments of at most this size, and only the newest LogSegmentCount of them are kept,
+    // so the log takes up a bounded amount of space no matter how long the console stays up
+    constexpr s64 MaxLogSegmentSize = 0x10'000;
+    constexpr u32 LogSegmentCount = 4;
+
+    // Lines are formatted straight into a slot of the ring, and the writer thread appends them to the file in batches
+    constexpr size_t LogSlotCount = 32;
+    constexpr size_t LogLineSize = 0x200 - sizeof(u32) - sizeof(u32);
+    static_assert((LogSlotCount & (LogSlotCount - 1)) == 0, "LogSlotCount has to be a power of two");
+
+    // How long the writer waits before writing out whatever has piled up
+    constexpr u64 FlushIntervalNs = 100'000'000;
+    // The trace rings fill up a lot quicker than the log does
+    constexpr u64 TraceFlushIntervalNs = 20'000'000;
+    // How long a line waits for room in a full ring before it is dropped. Kept short, logging must not stall its caller
+    constexpr u64 FullRingWaitNs = 100'000;
+    constexpr u32 FullRingRetries = 2;
+
+    struct LogSlot
+    {
+        // Equal to the ring position once the slot is free for it, and to the position + 1 once its line is ready
+        std::atomic<u32> sequence;
+        u32 length;
+        char text[LogLineSize];
+    };
+    static_assert(sizeof(LogSlot) == 0x200);
+
+    struct LogRing
+    {
+        LogSlot slots[LogSlotCount];
+        std::atomic<u32> enqueuePos{0};
+        std::atomic<u32> dequeuePos{0};
+        std::atomic<u32> droppedCount{0};
+
+        LogRing()
+        {
+            for (u32 i = 0; i != LogSlotCount; ++i)
+                slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    };
+
+    LogRing logRing;
+
     ams::fs::FileHandle LogFile;
+    bool logFileOpen = false;
+    s64 logOffset = 0;
+
+    // Writes are gathered here so that a batch of lines costs a single write
+    char batchBuffer[0x1000];
+    size_t batchLength = 0;
+
+    constexpr const char TraceFilePath[] = "sdmc:" CONFIG_PATH "trace.bin";
+    // Records past this size are thrown away, so a trace that was left on can't fill up the SD card
+    constexpr s64 MaxTraceFileSize = 0x400'000;
+
+    // The trace file starts with this header, followed by the event names (a length byte each) and then the records
+    struct TraceFileHeader
+    {
+        u32 magic;
+        u16 version;
+        u16 eventCount;
+        u64 tickFrequency;
+    };
+    constexpr u32 TraceFileMagic = 0x52544353; // SCTR
+    constexpr u16 TraceFileVersion = 1;
+
+    ams::fs::FileHandle TraceFile;
+    bool traceFileOpen = false;
+    bool traceFileFailed = false;
+    s64 traceOffset = 0;
+
+    TraceRecord traceBatch[0x1000 / sizeof(TraceRecord)];
+
+    UEvent g_logEvent;
+
+    // Thread to write the queued lines to the log file
+    void LogWriterThreadFunc(void *);
+
+    alignas(ams::os::ThreadStackAlignment) u8 log_thread_stack[0x2000];
+    SwitchWorkerThread g_log_thread;
 
     ams::os::Mutex printMutex(false);
 
-    ams::Result WriteToLogImpl(const char *fmt, std::va_list args)
+    // Claim the next free slot of the ring, or nullptr if the ring is full
+    LogSlot *ClaimSlot(u32 *outPos)
+    {
+        u32 pos = logRing.enqueuePos.load(std::memory_order_relaxed);
+        while (true)
+        {
+            LogSlot &slot = logRing.slots[pos & (LogSlotCount - 1)];
+            s32 diff = static_cast<s32>(slot.sequence.load(std::memory_order_acquire) - pos);
+
+            if (diff == 0)
+            {
+                if (logRing.enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    *outPos = pos;
+                    return &slot;
+                }
+            }
+            else if (diff < 0)
+            {
+                return nullptr;
+            }
+            else
+            {
+                pos = logRing.enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    void FormatLine(LogSlot *slot, const char *fmt, std::va_list args)
     {
         ams::TimeSpan ts = ams::os::ConvertToTimeSpan(ams::os::GetSystemTick());
 
+        // Print time
+        int len = ams::util::TSNPrintf(slot->text, sizeof(slot->text), "%02lid %02li:%02li:%02li: ",
+                                       ts.GetDays(),
+                                       ts.GetHours() % 24,
+                                       ts.GetMinutes() % 60,
+                                       ts.GetSeconds() % 60);
+
+        // Print the actual text, a line that doesn't fit is cut short but still ends with a newline
+        len += ams::util::TVSNPrintf(&slot->text[len], sizeof(slot->text) - len, fmt, args);
+        len = std::min<int>(len, sizeof(slot->text) - 2);
+        slot->text[len++] = '\n';
+
+        slot->length = len;
+    }
+
+    ams::Result OpenLogFile()
+    {
         // Check if log file exists and create it if not
         bool has_file;
-        R_ABORT_UNLESS(ams::fs::HasFile(&has_file, LogFilePath));
+        R_TRY(ams::fs::HasFile(&has_file, LogFilePath));
         if (!has_file)
         {
-            R_ABORT_UNLESS(ams::fs::EnsureDirectory("sdmc:" CONFIG_PATH));
-            R_ABORT_UNLESS(ams::fs::CreateFile(LogFilePath, 0));
+            R_TRY(ams::fs::EnsureDirectory("sdmc:" CONFIG_PATH));
+            R_TRY(ams::fs::CreateFile(LogFilePath, 0));
         }
 
-        R_ABORT_UNLESS(ams::fs::OpenFile(&LogFile, LogFilePath, ams::fs::OpenMode_Write | ams::fs::OpenMode_AllowAppend));
-        ON_SCOPE_EXIT { ams::fs::CloseFile(LogFile); };
+        R_TRY(ams::fs::OpenFile(&LogFile, LogFilePath, ams::fs::OpenMode_Write | ams::fs::OpenMode_AllowAppend));
+        if (R_FAILED(ams::fs::GetFileSize(&logOffset, LogFile)))
+        {
+            ams::fs::CloseFile(LogFile);
+            R_RETURN(1);
+        }
 
-        s64 logOffset;
-        R_ABORT_UNLESS(ams::fs::GetFileSize(&logOffset, LogFile));
+        logFileOpen = true;
+        R_SUCCEED();
+    }
 
-        char buff[0x200];
+    // Segment 0 is the one being written to, the higher the number the older the segment
+    void GetLogSegmentPath(char (&path)[0x40], u32 index)
+    {
+        if (index == 0)
+            ams::util::TSNPrintf(path, sizeof(path), "%s", LogFilePath);
+        else
+            ams::util::TSNPrintf(path, sizeof(path), "sdmc:" CONFIG_PATH "log.%u.txt", index);
+    }
 
-        // Print time
-        int len = ams::util::TSNPrintf(buff, sizeof(buff), "%02lid %02li:%02li:%02li: ",
-                                       ts.GetDays(),
-                                       ts.GetHours() % 24,
-                                       ts.GetMinutes() % 60,
-                                       ts.GetSeconds() % 60);
+    // Move every segment one up, dropping the oldest one, and start over with an empty log.txt
+    void RotateLogs()
+    {
+        ams::fs::FlushFile(LogFile);
+        ams::fs::CloseFile(LogFile);
+        logFileOpen = false;
+
+        char from[0x40];
+        char to[0x40];
+        bool has_file;
+
+        GetLogSegmentPath(to, LogSegmentCount - 1);
+        if (R_SUCCEEDED(ams::fs::HasFile(&has_file, to)) && has_file)
+            ams::fs::DeleteFile(to);
+
+        for (u32 i = LogSegmentCount - 1; i != 0; --i)
+        {
+            GetLogSegmentPath(from, i - 1);
+            GetLogSegmentPath(to, i);
+            if (R_SUCCEEDED(ams::fs::HasFile(&has_file, from)) && has_file)
+                ams::fs::RenameFile(from, to);
+        }
+
+        OpenLogFile();
+    }
+
+    void FlushBatch()
+    {
+        if (batchLength == 0)
+            return;
+
+        // Start a new segment rather than letting the current one grow past the cap
+        if (logFileOpen && logOffset != 0 && logOffset + static_cast<s64>(batchLength) > MaxLogSegmentSize)
+            RotateLogs();
+
+        if (logFileOpen && R_SUCCEEDED(ams::fs::WriteFile(LogFile, logOffset, batchBuffer, batchLength, ams::fs::WriteOption::None)))
+            logOffset += batchLength;
+
+        batchLength = 0;
+    }
+
+    void AppendToBatch(const char *text, size_t length)
+    {
+        if (batchLength + length > sizeof(batchBuffer))
+            FlushBatch();
 
-        // Print the actual text
-        len += ams::util::TVSNPrintf(&buff[len], sizeof(buff) - len, fmt, args);
-        len += ams::util::TSNPrintf(&buff[len], sizeof(buff) - len, "\n");
+        std::memcpy(&batchBuffer[batchLength], text, length);
+        batchLength += length;
+    }
+
+    // Write out every line that is ready. Lines are taken in order, so a line that is still being formatted holds back the ones after it
+    void DrainLog()
+    {
+        u32 pos = logRing.dequeuePos.load(std::memory_order_relaxed);
+        bool wroteAny = false;
+
+        while (true)
+        {
+            LogSlot &slot = logRing.slots[pos & (LogSlotCount - 1)];
+            if (slot.sequence.load(std::memory_order_acquire) != pos + 1)
+                break;
+
+            AppendToBatch(slot.text, slot.length);
+            slot.sequence.store(pos + LogSlotCount, std::memory_order_release);
+            logRing.dequeuePos.store(++pos, std::memory_order_relaxed);
+            wroteAny = true;
+        }
+
+        if (u32 dropped = logRing.droppedCount.exchange(0, std::memory_order_relaxed); dropped != 0)
+        {
+            char line[0x40];
+            int len = ams::util::TSNPrintf(line, sizeof(line), "%u log lines were dropped\n", dropped);
+            AppendToBatch(line, len);
+            wroteAny = true;
+        }
+
+        if (!wroteAny)
+            return;
+
+        FlushBatch();
+        if (logFileOpen)
+            ams::fs::FlushFile(LogFile);
+    }
+
+    // A trace only covers a single session, so the first one to be turned on replaces the previous session's file
+    ams::Result OpenTraceFile()
+    {
+        bool has_file;
+        R_TRY(ams::fs::HasFile(&has_file, TraceFilePath));
+        if (has_file)
+            R_TRY(ams::fs::DeleteFile(TraceFilePath));
 
-        R_ABORT_UNLESS(ams::fs::WriteFile(LogFile, logOffset, buff, len, ams::fs::WriteOption::Flush));
+        R_TRY(ams::fs::EnsureDirectory("sdmc:" CONFIG_PATH));
+        R_TRY(ams::fs::CreateFile(TraceFilePath, 0));
+        R_TRY(ams::fs::OpenFile(&TraceFile, TraceFilePath, ams::fs::OpenMode_Write | ams::fs::OpenMode_AllowAppend));
 
+        u8 header[0x200];
+        size_t length = sizeof(TraceFileHeader);
+
+        TraceFileHeader fileHeader{TraceFileMagic, TraceFileVersion, TraceEvent_Count, armGetSystemTickFreq()};
+        std::memcpy(header, &fileHeader, sizeof(fileHeader));
+
+        for (const char *name : SwitchTrace::EventNames)
+        {
+            size_t nameLength = std::min<size_t>(std::strlen(name), UINT8_MAX);
+            if (length + 1 + nameLength > sizeof(header))
+                break;
+
+            header[length++] = nameLength;
+            std::memcpy(&header[length], name, nameLength);
+            length += nameLength;
+        }
+
+        if (R_FAILED(ams::fs::WriteFile(TraceFile, 0, header, length, ams::fs::WriteOption::Flush)))
+        {
+            ams::fs::CloseFile(TraceFile);
+            R_RETURN(1);
+        }
+
+        traceOffset = length;
+        traceFileOpen = true;
         R_SUCCEED();
     }
 
+    void DrainTrace()
+    {
+        bool wroteAny = false;
+        size_t count;
+
+        // A batch that comes back short means every ring has been read out
+        do
+        {
+            count = SwitchTrace::Drain(traceBatch, std::size(traceBatch));
+
+            s64 size = count * sizeof(TraceRecord);
+            if (size == 0 || traceOffset + size > MaxTraceFileSize)
+                continue;
+
+            if (R_SUCCEEDED(ams::fs::WriteFile(TraceFile, traceOffset, traceBatch, size, ams::fs::WriteOption::None)))
+            {
+                traceOffset += size;
+                wroteAny = true;
+            }
+        } while (count == std::size(traceBatch));
+
+        if (wroteAny)
+            ams::fs::FlushFile(TraceFile);
+    }
+
+    void LogWriterThreadFunc(void *)
+    {
+        // Lines that come in while the SD card can't be written to are thrown away rather than holding up their callers
+        if (!logFileOpen)
+            OpenLogFile();
+
+        DrainLog();
+
+        // Only the first attempt at opening the trace counts, a failed one is reported once instead of retried every pass
+        if (SwitchTrace::IsEnabled() && !traceFileOpen && !traceFileFailed && R_FAILED(OpenTraceFile()))
+        {
+            traceFileFailed = true;
+            LOG_ERROR("Failed to create the trace file");
+        }
+
+        if (traceFileOpen)
+            DrainTrace();
+
+        g_log_thread.Wait(waiterForUEvent(&g_logEvent), SwitchTrace::IsEnabled() ? TraceFlushIntervalNs : FlushIntervalNs);
+    }
+
 } // namespace
 
-ams::Result DiscardOldLogs()
+bool ParseLogLevel(const char *name, LogLevel *out)
 {
-    std::scoped_lock printLock(printMutex);
+    constexpr const char *levelNames[] = {"debug", "info", "warning", "error", "none"};
+    static_assert(std::size(levelNames) == LogLevel_None + 1);
 
-    s64 fileSize;
+    for (u8 i = 0; i != std::size(levelNames); ++i)
     {
-        R_TRY(ams::fs::OpenFile(&LogFile, LogFilePath, ams::fs::OpenMode_Read));
-        ON_SCOPE_EXIT { ams::fs::CloseFile(LogFile); };
-
-        R_TRY(ams::fs::GetFileSize(&fileSize, LogFile));
+        if (strcasecmp(name, levelNames[i]) == 0)
+        {
+            *out = static_cast<LogLevel>(i);
+            return true;
+        }
     }
+    return false;
+}
+
+ams::Result StartLogWriter()
+{
+    ueventCreate(&g_logEvent, true);
+    R_RETURN(g_log_thread.Start(&LogWriterThreadFunc, nullptr, log_thread_stack, sizeof(log_thread_stack), 0x3F));
+}
+
+void StopLogWriter()
+{
+    g_log_thread.Join();
 
-    if (fileSize >= 0x20'000)
+    // Write out whatever came in after the writer's last pass
+    DrainLog();
+
+    if (traceFileOpen)
     {
-        R_TRY(ams::fs::DeleteFile(LogFilePath));
-        WriteToLog("Deleted previous log file");
+        DrainTrace();
+        ams::fs::CloseFile(TraceFile);
+        traceFileOpen = false;
     }
 
-    R_SUCCEED();
+    if (logFileOpen)
+    {
+        ams::fs::CloseFile(LogFile);
+        logFileOpen = false;
+    }
 }
 
 void WriteToLog(const char *fmt, ...)
 {
-    std::scoped_lock printLock(printMutex);
+    u32 pos;
+    LogSlot *slot = ClaimSlot(&pos);
+
+    // The writer runs at the lowest priority, so a burst can fill the ring before it gets a chance to run
+    for (u32 i = 0; slot == nullptr && i != FullRingRetries && g_log_thread.IsRunning(); ++i)
+    {
+        ueventSignal(&g_logEvent);
+        svcSleepThread(FullRingWaitNs);
+        slot = ClaimSlot(&pos);
+    }
+
+    if (slot == nullptr)
+    {
+        logRing.droppedCount.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
 
     std::va_list args;
     va_start(args, fmt);
-    R_ABORT_UNLESS(WriteToLogImpl(fmt, args));
+    FormatLine(slot, fmt, args);
     va_end(args);
+
+    slot->sequence.store(pos + 1, std::memory_order_release);
+
+    // Only wake the writer early once the ring is getting full, otherwise lines are written out every flush interval
+    if (pos - logRing.dequeuePos.load(std::memory_order_relaxed) >= LogSlotCount / 2)
+        ueventSignal(&g_logEvent);
 }
 
 void LockedUpdateConsole()
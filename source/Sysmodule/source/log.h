@@ -1,10 +1,61 @@
 #pragma once
-#include "config_handler.h"
+#include <switch.h>
+#include <stratosphere.hpp>
+#include <atomic>
 
 // #define LOG_PATH CONFIG_PATH "log.txt"
 
-ams::Result DiscardOldLogs();
+enum LogLevel : u8
+{
+    LogLevel_Debug,
+    LogLevel_Info,
+    LogLevel_Warning,
+    LogLevel_Error,
+    LogLevel_None,
+};
 
+// Log calls below this level are compiled out along with their arguments. Debug builds keep all of them
+#ifndef SYSCON_MIN_LOG_LEVEL
+#ifdef AMS_BUILD_FOR_DEBUGGING
+#define SYSCON_MIN_LOG_LEVEL LogLevel_Debug
+#else
+#define SYSCON_MIN_LOG_LEVEL LogLevel_Info
+#endif
+#endif
+
+// Log calls below this level are skipped before any formatting is done, set by log_level in config_global.ini
+inline std::atomic<LogLevel> logLevelThreshold{LogLevel_Info};
+
+inline bool IsLogLevelEnabled(LogLevel level)
+{
+    return level >= logLevelThreshold.load(std::memory_order_relaxed);
+}
+
+// Turn the name of a log level (debug, info, warning, error, none) into its value
+bool ParseLogLevel(const char *name, LogLevel *out);
+
+// Start the thread that writes logged lines to the SD card. Lines logged before this are kept until it runs
+ams::Result StartLogWriter();
+// Write out the remaining lines and stop the writer thread
+void StopLogWriter();
+
+// Queue a line for the log file. This only formats the line, the file is written to by the writer thread.
+// Use the LOG_ macros below instead, which skip disabled levels
 void WriteToLog(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
 
+#define SYSCON_LOG(level, ...)                              \
+    do                                                      \
+    {                                                       \
+        if constexpr ((level) >= SYSCON_MIN_LOG_LEVEL)      \
+        {                                                   \
+            if (IsLogLevelEnabled(level))                   \
+                WriteToLog(__VA_ARGS__);                    \
+        }                                                   \
+    } while (false)
+
+#define LOG_DEBUG(...)   SYSCON_LOG(LogLevel_Debug, __VA_ARGS__)
+#define LOG_INFO(...)    SYSCON_LOG(LogLevel_Info, __VA_ARGS__)
+#define LOG_WARNING(...) SYSCON_LOG(LogLevel_Warning, __VA_ARGS__)
+#define LOG_ERROR(...)   SYSCON_LOG(LogLevel_Error, __VA_ARGS__)
+
 void LockedUpdateConsole();
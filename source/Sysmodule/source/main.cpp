@@ -6,6 +6,8 @@
 #include "controller_handler.h"
 #include "config_handler.h"
 #include "psc_module.h"
+#include "title_module.h"
+#include "service_module.h"
 #include "SwitchHDLHandler.h"
 
 #define APP_VERSION "0.6.4"
@@ -102,21 +104,25 @@ namespace ams
 
     void Main()
     {
-        WriteToLog("\n\nNew sysmodule session started on version " APP_VERSION);
+        R_ABORT_UNLESS(StartLogWriter());
+        LOG_INFO("\n\nNew sysmodule session started on version " APP_VERSION);
         R_ABORT_UNLESS(syscon::config::Initialize());
+        // The handler slots and the aggregator have to be set up before discovery can insert any controller
+        syscon::controllers::Initialize();
         R_ABORT_UNLESS(syscon::usb::Initialize());
         R_ABORT_UNLESS(syscon::psc::Initialize());
-        syscon::controllers::Initialize();
+        R_ABORT_UNLESS(syscon::title::Initialize());
+        R_ABORT_UNLESS(syscon::service::Initialize());
 
-        while (true)
-        {
-            svcSleepThread(1e+8L);
-        }
+        // Serve the control service on the main thread for the rest of the session
+        syscon::service::LoopProcess();
 
-        syscon::controllers::Exit();
+        syscon::title::Exit();
         syscon::psc::Exit();
         syscon::usb::Exit();
+        syscon::controllers::Exit();
         syscon::config::Exit();
+        StopLogWriter();
     }
 
 } // namespace ams
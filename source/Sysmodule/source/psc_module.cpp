@@ -4,6 +4,7 @@
 #include "config_handler.h"
 #include "controller_handler.h"
 #include "log.h"
+#include "SwitchWorkerThread.h"
 
 namespace syscon::psc
 {
@@ -11,44 +12,46 @@ namespace syscon::psc
     {
         PscPmModule pscModule;
         Waiter pscModuleWaiter;
-        const uint32_t dependencies[] = {PscPmModuleId_Fs};
+        // Depending on usb makes us go to sleep before it does and wake up after it, so the controllers can be suspended and resumed
+        const uint32_t dependencies[] = {PscPmModuleId_Usb, PscPmModuleId_Fs};
 
         // Thread to check for psc:pm state change (console waking up/going to sleep)
         void PscThreadFunc(void *);
 
         alignas(ams::os::ThreadStackAlignment) u8 psc_thread_stack[0x1000];
-        Thread g_psc_thread;
-
-        bool is_psc_thread_running = false;
+        SwitchWorkerThread g_psc_thread;
 
         void PscThreadFunc(void *)
         {
-            do
+            if (g_psc_thread.Wait(pscModuleWaiter))
             {
-                if (R_SUCCEEDED(waitSingle(pscModuleWaiter, UINT64_MAX)))
+                PscPmState pscState;
+                u32 out_flags;
+                if (R_SUCCEEDED(pscPmModuleGetRequest(&pscModule, &pscState, &out_flags)))
                 {
-                    PscPmState pscState;
-                    u32 out_flags;
-                    if (R_SUCCEEDED(pscPmModuleGetRequest(&pscModule, &pscState, &out_flags)))
+                    switch (pscState)
                     {
-                        switch (pscState)
-                        {
-                            case PscPmState_Awake:
-                            case PscPmState_ReadyAwaken:
-                                // usb::CreateUsbEvents();
-                                break;
-                            case PscPmState_ReadySleep:
-                            case PscPmState_ReadyShutdown:
-                                // usb::DestroyUsbEvents();
-                                controllers::Reset();
-                                break;
-                            default:
-                                break;
-                        }
-                        pscPmModuleAcknowledge(&pscModule, pscState);
+                        case PscPmState_Awake:
+                            break;
+                        case PscPmState_ReadyAwaken:
+                            controllers::Resume();
+                            if (ams::Result rc = usb::Resume(); R_FAILED(rc))
+                                LOG_ERROR("Failed to resume usb discovery: 0x%x", rc.GetValue());
+                            break;
+                        case PscPmState_ReadySleep:
+                            // Stop discovery first, or it could insert a handler that never gets suspended
+                            usb::Suspend();
+                            controllers::Suspend();
+                            break;
+                        case PscPmState_ReadyShutdown:
+                            controllers::Reset();
+                            break;
+                        default:
+                            break;
                     }
+                    pscPmModuleAcknowledge(&pscModule, pscState);
                 }
-            } while (is_psc_thread_running);
+            }
         }
     } // namespace
 
@@ -56,23 +59,17 @@ namespace syscon::psc
     {
         R_TRY(pscmGetPmModule(&pscModule, PscPmModuleId(126), dependencies, sizeof(dependencies) / sizeof(uint32_t), true));
         pscModuleWaiter = waiterForEvent(&pscModule.event);
-        is_psc_thread_running = true;
-        R_TRY(threadCreate(&g_psc_thread, &PscThreadFunc, nullptr, psc_thread_stack, sizeof(psc_thread_stack), 0x2C, -2));
-        R_TRY(threadStart(&g_psc_thread));
+        R_TRY(g_psc_thread.Start(&PscThreadFunc, nullptr, psc_thread_stack, sizeof(psc_thread_stack), 0x2C));
 
         R_SUCCEED();
     }
 
     void Exit()
     {
-        is_psc_thread_running = false;
+        g_psc_thread.Join();
 
         pscPmModuleFinalize(&pscModule);
         pscPmModuleClose(&pscModule);
         eventClose(&pscModule.event);
-
-        svcCancelSynchronization(g_psc_thread.handle);
-        threadWaitForExit(&g_psc_thread);
-        threadClose(&g_psc_thread);
     }
 }; // namespace syscon::psc
\ No newline at end of file
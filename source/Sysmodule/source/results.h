@@ -0,0 +1,14 @@
+#pragma once
+#include <stratosphere.hpp>
+
+// Results of sys-con's own, so they decode to something meaningful instead of a bare number, for clients of the control service too
+namespace syscon
+{
+    R_DEFINE_NAMESPACE_RESULT_MODULE(497);
+
+    R_DEFINE_ERROR_RESULT(InvalidArgument, 1);
+    R_DEFINE_ERROR_RESULT(UnknownConfigFile, 2);
+    R_DEFINE_ERROR_RESULT(InvalidConfigValue, 3);
+    R_DEFINE_ERROR_RESULT(UnknownFeature, 4);
+    R_DEFINE_ERROR_RESULT(ThreadAlreadyRunning, 5);
+} // namespace syscon
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include "service_module.h"
+#include <stratosphere.hpp>
+#include <cstring>
+#include "config_handler.h"
+#include "controller_handler.h"
+#include "title_module.h"
+#include "log.h"
+#include "results.h"
+
+#define AMS_SYSCON_I_CONTROL_INTERFACE_INTERFACE_INFO(C, H)                                                                                                        \
+    AMS_SF_METHOD_INFO(C, H, 0, ams::Result, GetVersion, (ams::sf::Out<u32> out), (out))                                                                           \
+    AMS_SF_METHOD_INFO(C, H, 1, ams::Result, ListControllers, (ams::sf::Out<s32> out_count, const ams::sf::OutArray<syscon::service::ControllerInfo> &out), (out_count, out)) \
+    AMS_SF_METHOD_INFO(C, H, 2, ams::Result, ReloadConfig, (), ())                                                                                                \
+    AMS_SF_METHOD_INFO(C, H, 3, ams::Result, SetConfigValue, (u32 file, const ams::sf::InBuffer &name, const ams::sf::InBuffer &value), (file, name, value))       \
+    AMS_SF_METHOD_INFO(C, H, 4, ams::Result, SetFeatureEnabled, (u32 feature, bool enabled), (feature, enabled))
+
+AMS_SF_DEFINE_INTERFACE(syscon::service, IControlInterface, AMS_SYSCON_I_CONTROL_INTERFACE_INTERFACE_INFO, 0x5C0C7A11)
+
+namespace syscon::service
+{
+    namespace
+    {
+        constexpr ams::sm::ServiceName ControlServiceName = ams::sm::ServiceName::Encode("sys:con");
+        constexpr size_t MaxSessions = 4;
+
+        struct ServerOptions
+        {
+            static constexpr size_t PointerBufferSize = 0x100;
+            static constexpr size_t MaxDomains = 0;
+            static constexpr size_t MaxDomainObjects = 0;
+            static constexpr bool CanDeferInvokeRequest = false;
+            static constexpr bool CanManageMitmServers = false;
+        };
+
+        using ServerManager = ams::sf::hipc::ServerManager<1, ServerOptions, MaxSessions>;
+        ServerManager g_server_manager;
+
+        // Copies a string argument out of its buffer, the client doesn't have to terminate it
+        bool CopyString(char *out, size_t size, const ams::sf::InBuffer &buffer)
+        {
+            if (buffer.GetSize() == 0 || buffer.GetSize() >= size)
+                return false;
+
+            std::memcpy(out, buffer.GetPointer(), buffer.GetSize());
+            out[buffer.GetSize()] = '\0';
+            return true;
+        }
+
+        class ControlService
+        {
+        public:
+            ams::Result GetVersion(ams::sf::Out<u32> out)
+            {
+                out.SetValue(ServiceVersion);
+                R_SUCCEED();
+            }
+
+            ams::Result ListControllers(ams::sf::Out<s32> out_count, const ams::sf::OutArray<ControllerInfo> &out)
+            {
+                std::scoped_lock lock(controllers::GetScopedLock());
+
+                size_t count = 0;
+                for (auto &handler : controllers::Get())
+                {
+                    if (count == out.GetSize())
+                        break;
+
+                    IController *controller = handler->GetController();
+                    GamepadHandlerStats stats = handler->GetStats();
+                    out[count++] = ControllerInfo{
+                        .vendor_id = controller->GetDevice()->GetVendor(),
+                        .product_id = controller->GetDevice()->GetProduct(),
+                        .type = static_cast<u8>(controller->GetType()),
+                        .lost = handler->IsDeviceLost(),
+                        .reserved = {},
+                        .inputCount = stats.inputCount,
+                        .failedInputCount = stats.failedInputCount,
+                        .deviceResetCount = stats.deviceResetCount,
+                    };
+                }
+
+                out_count.SetValue(static_cast<s32>(count));
+                R_SUCCEED();
+            }
+
+            ams::Result ReloadConfig()
+            {
+                config::RequestReload();
+                R_SUCCEED();
+            }
+
+            ams::Result SetConfigValue(u32 file, const ams::sf::InBuffer &name, const ams::sf::InBuffer &value)
+            {
+                char nameString[64];
+                char valueString[128];
+                R_UNLESS(file < config::ConfigFile_Count, ResultUnknownConfigFile());
+                R_UNLESS(CopyString(nameString, sizeof(nameString), name) && CopyString(valueString, sizeof(valueString), value), ResultInvalidArgument());
+
+                R_RETURN(config::SetConfigValue(static_cast<config::ConfigFile>(file), nameString, valueString));
+            }
+
+            ams::Result SetFeatureEnabled(u32 feature, bool enabled)
+            {
+                LOG_INFO("%s feature %u over IPC", enabled ? "Enabling" : "Disabling", feature);
+                switch (feature)
+                {
+                    case ControlFeature_ConfigPolling:
+                        if (!enabled)
+                        {
+                            config::Disable();
+                            R_SUCCEED();
+                        }
+                        R_RETURN(config::Enable());
+                    case ControlFeature_TitleProfiles:
+                        if (!enabled)
+                        {
+                            title::Disable();
+                            R_SUCCEED();
+                        }
+                        R_RETURN(title::Enable());
+                    default:
+                        R_THROW(ResultUnknownFeature());
+                }
+            }
+        };
+        static_assert(IsIControlInterface<ControlService>);
+
+        ams::sf::UnmanagedServiceObject<IControlInterface, ControlService> g_control_service;
+    } // namespace
+
+    ams::Result Initialize()
+    {
+        R_TRY(g_server_manager.RegisterObjectForServer(g_control_service.GetShared(), ControlServiceName, MaxSessions));
+        LOG_DEBUG("Registered the control service");
+
+        R_SUCCEED();
+    }
+
+    void LoopProcess()
+    {
+        g_server_manager.LoopProcess();
+    }
+} // namespace syscon::service
\ No newline at end of file
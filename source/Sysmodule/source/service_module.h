@@ -0,0 +1,42 @@
+#pragma once
+#include <switch.h>
+#include <stratosphere.hpp>
+
+// The control service, for tools that want to talk to sys-con without going through the files on the SD card
+namespace syscon::service
+{
+    // Bumped whenever a command is added or changes
+    constexpr u32 ServiceVersion = 1;
+
+    enum ControlCommand : u32
+    {
+        ControlCommand_GetVersion = 0,
+        ControlCommand_ListControllers = 1,
+        ControlCommand_ReloadConfig = 2,
+        ControlCommand_SetConfigValue = 3,
+        ControlCommand_SetFeatureEnabled = 4,
+    };
+
+    enum ControlFeature : u32
+    {
+        ControlFeature_ConfigPolling = 0, // Checking the config files for changes
+        ControlFeature_TitleProfiles = 1, // Switching to the profile of the title in the foreground
+    };
+
+    struct ControllerInfo
+    {
+        u16 vendor_id;
+        u16 product_id;
+        u8 type; // ControllerType
+        bool lost;
+        u8 reserved[2];
+        u32 inputCount;
+        u32 failedInputCount;
+        u32 deviceResetCount;
+    };
+    static_assert(sizeof(ControllerInfo) == 0x14);
+
+    ams::Result Initialize();
+    // Handles requests on the calling thread, doesn't return
+    void LoopProcess();
+} // namespace syscon::service
\ No newline at end of file
@@ -0,0 +1,75 @@
+#include "title_module.h"
+#include <stratosphere.hpp>
+#include "config_handler.h"
+#include "log.h"
+#include "SwitchWorkerThread.h"
+
+namespace syscon::title
+{
+    namespace
+    {
+        // pm only reports application launches to a single hook, which is taken by debuggers, so the foreground title is polled instead
+        constexpr u64 PollIntervalNs = 500'000'000;
+
+        u64 activeProgramId = 0;
+
+        // Thread to check for the application that's running
+        void TitleThreadFunc(void *);
+
+        alignas(ams::os::ThreadStackAlignment) u8 title_thread_stack[0x1000];
+        SwitchWorkerThread g_title_thread;
+
+        u64 GetApplicationProgramId()
+        {
+            u64 processId = 0;
+            u64 programId = 0;
+            if (R_FAILED(pmdmntGetApplicationProcessId(&processId)) || R_FAILED(pminfoGetProgramId(&programId, processId)))
+                return 0;
+            return programId;
+        }
+
+        void TitleThreadFunc(void *)
+        {
+            u64 programId = GetApplicationProgramId();
+            if (programId != activeProgramId)
+            {
+                activeProgramId = programId;
+                config::SetActiveTitle(programId);
+            }
+
+            g_title_thread.Sleep(PollIntervalNs);
+        }
+    } // namespace
+
+    ams::Result Initialize()
+    {
+        R_RETURN(Enable());
+    }
+
+    void Exit()
+    {
+        Disable();
+    }
+
+    ams::Result Enable()
+    {
+        // Already running is what the caller asked for
+        if (g_title_thread.IsRunning())
+            R_SUCCEED();
+
+        R_TRY(g_title_thread.Start(&TitleThreadFunc, nullptr, title_thread_stack, sizeof(title_thread_stack), 0x3E));
+
+        R_SUCCEED();
+    }
+
+    void Disable()
+    {
+        g_title_thread.Join();
+
+        if (activeProgramId != 0)
+        {
+            activeProgramId = 0;
+            config::SetActiveTitle(0);
+        }
+    }
+}; // namespace syscon::title
\ No newline at end of file
@@ -0,0 +1,13 @@
+#pragma once
+#include <switch.h>
+#include <stratosphere.hpp>
+
+namespace syscon::title
+{
+    ams::Result Initialize();
+    void Exit();
+
+    ams::Result Enable();
+    // Also goes back to the configs without a title profile
+    void Disable();
+};
\ No newline at end of file
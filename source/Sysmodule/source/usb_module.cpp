@@ -6,323 +6,418 @@
 #include <stratosphere.hpp>
 
 #include "SwitchUSBDevice.h"
+#include "SwitchWorkerThread.h"
 #include "ControllerHelpers.h"
+#include "ControllerDatabase.h"
 #include "log.h"
 #include <string.h>
+#include <algorithm>
 
 namespace syscon::usb
 {
     namespace
     {
         constexpr u8 CatchAllEventIndex = 2;
-        constexpr u8 SonyEventIndex = 0;
 
-        constexpr size_t MaxUsbHsInterfacesSize = 16;
+        // As many interfaces as usb:hs keeps track of. Interfaces nobody acquires stay available (audio interfaces,
+        // the extra Xbox 360 interfaces, other USB devices), so a smaller buffer could fill up with those and miss a controller
+        constexpr size_t MaxUsbHsInterfacesSize = 32;
 
-        ams::os::Mutex usbMutex(false);
-
-        // Thread that waits on generic usb event
+        // Thread that waits on generic usb event and picks up every supported interface
         void UsbEventThreadFunc(void *);
-        // Thread that waits on sony vendor usb event
-        void UsbSonyEventThreadFunc(void *);
         // Thread that waits on any disconnected usb devices
         void UsbInterfaceChangeThreadFunc(void *);
+        // Threads that initialize the controllers found by the event thread. Each one runs a single controller's
+        // init sequence at a time, so controllers plugged in together don't wait on each other's handshakes
+        void UsbInitThreadFunc(void *);
+
+        constexpr size_t UsbInitThreadCount = 3;
 
         alignas(ams::os::ThreadStackAlignment) u8 usb_event_thread_stack[0x2000];
-        alignas(ams::os::ThreadStackAlignment) u8 sony_event_thread_stack[0x2000];
         alignas(ams::os::ThreadStackAlignment) u8 usb_interface_change_thread_stack[0x2000];
+        alignas(ams::os::ThreadStackAlignment) u8 usb_init_thread_stacks[UsbInitThreadCount][0x2000];
 
-        Thread g_usb_event_thread;
-        Thread g_sony_event_thread;
-        Thread g_usb_interface_change_thread;
-
-        bool is_usb_event_thread_running = false;
-        bool is_usb_interface_change_thread_running = false;
+        SwitchWorkerThread g_usb_event_thread;
+        SwitchWorkerThread g_usb_interface_change_thread;
+        std::array<SwitchWorkerThread, UsbInitThreadCount> g_usb_init_threads;
 
         Event g_usbCatchAllEvent{};
-        Event g_usbSonyEvent{};
-        UsbHsInterface interfaces[MaxUsbHsInterfacesSize];
+        // Signaled by handlers that gave up on their device, which may not come with an interface state change
+        UEvent g_handlerLostEvent;
 
-        HardwareId ps3_hardware_ids[] =
-            {
-                {0x054c, 0x0268}, // DS3
-                {0x0f0d, 0x0022}, // Hori Co., Ltd
-                {0x0f0d, 0x0088}, // hori mini Arcade Stick
-                {0x1c1a, 0x0100}, // datel Arcade Stick
-                {0x0079, 0x181a}, // venom
-                {0x1532, 0x0402}, // Razer Panthera
-                {0x0f0d, 0x0085}, // Hori Fighting Commander v4
+        void OnHandlerDeviceLost()
+        {
+            ueventSignal(&g_handlerLostEvent);
+        }
+
+        // Controllers whose interfaces were acquired, waiting for an init thread to run their init sequence
+        struct PendingController
+        {
+            std::unique_ptr<IController> controller;
+            const char *name;
+            s32 slot;
         };
 
-        // hori fighting command in pc mode (0x0f0d, 0x0086)
+        constexpr size_t MaxPendingControllersSize = 8;
+
+        std::array<PendingController, MaxPendingControllersSize> pendingControllers;
+        size_t pendingControllersHead = 0;
+        size_t pendingControllersCount = 0;
+        ams::os::Mutex pendingControllersMutex(false);
+        UEvent g_pendingControllersEvent;
 
-        // got many from real hardware. And a lot from here:
-        // https://github.com/Raphfriend/USB2DB15/blob/master/RFUSB_to_DB15/drivers.h#L39
-        HardwareId ps4_hardware_ids[] =
+        // Only called by the event thread. Only the interface acquisition happens here, the slow init sequence
+        // runs on the init threads so the lock isn't held while talking to the device
+        // The controller's slot is given back if it can't be queued
+        void QueueController(std::unique_ptr<IController> &&controller, const char *name, s32 slot)
+        {
+            ams::Result res = controller->GetDevice()->Open();
+            if (R_FAILED(res))
             {
-                {0x054c, 0x05c4}, // DS4 v1
-                {0x054c, 0x09cc}, // DS4 v2
-                {0x054c, 0x0ba0}, // PS4 wireless Adapter
-                {0x0c12, 0x0c30}, // Brooks Universal Fighting Board (PS4 mode)
-                {0x0c12, 0x0ef1}, // Brooks PS2 -> PS4 Adapter
-                {0x0c12, 0x1cf2}, // Brooks PS3 -> PS4 Adapter
-                {0x0c12, 0x0e31}, // Brooks PS4 Audio Board
-                {0x0c12, 0x0ef7}, // Brooks tiny square PS4 Board
-                {0x0c12, 0x0ef8}, // Brooks Fighting Board
-                {0x0f0d, 0x0087}, // Hori Mini Arcade Stick
-                {0x0f0d, 0x0084}, // Hori Fighting Commander v4
-                {0x0f0d, 0x00ae}, // Hori RAP Pro N Hayabusa
-                {0x0f0d, 0x008a}, // HORI RAP V Hayabusa
-                {0x0f0d, 0x00ee}, // HORI ワイヤードコントローラライト for PS4-102
-                {0x0f0d, 0x006f}, // HORI RAP Pro VLX
-                {0x1f4f, 0x1002}, // Xrd PS4 Pad
-                {0x0079, 0x181b}, // Venom Arcade Stick
-                {0x1532, 0x0401}, // Razer Panthera
-                {0x1532, 0x1008}, // Razer Panthera EVO
-                {0x1532, 0x1004}, // Razer Raiju Ultimate
-                {0x2c22, 0x2000}, // Qanba Drone
-                {0x2c22, 0x2200}, // Qanba Crystal
-                {0x2c22, 0x2300}, // Qanba Obsidian
-                {0x0738, 0x8180}, // Mad Catz Fight Stick Alpha
-                {0x0738, 0x8481}, // Mad Catz SFV Arcade FightStick TE2+
-                {0x0738, 0x8384}, // Mad Catz SFV Arcade FightStick TES+
-                {0x0738, 0x8250}, // Mad Catz FightPad PRO PS4
-                {0x146b, 0x0d09}, // Nacon Daija
-        };
+                LOG_ERROR("Failed to acquire %s controller: 0x%x", name, res.GetValue());
+                controllers::ReleaseSlot(slot);
+                return;
+            }
 
+            std::scoped_lock pendingLock(pendingControllersMutex);
+            if (pendingControllersCount == pendingControllers.size())
+            {
+                LOG_WARNING("Too many controllers waiting for init, dropping %s controller", name);
+                controllers::ReleaseSlot(slot);
+                return;
+            }
+
+            pendingControllers[(pendingControllersHead + pendingControllersCount++) % pendingControllers.size()] = {std::move(controller), name, slot};
+            ueventSignal(&g_pendingControllersEvent);
+        }
+
+        bool PopPendingController(PendingController *out)
+        {
+            std::scoped_lock pendingLock(pendingControllersMutex);
+            if (pendingControllersCount == 0)
+                return false;
+
+            *out = std::move(pendingControllers[pendingControllersHead]);
+            pendingControllersHead = (pendingControllersHead + 1) % pendingControllers.size();
+            --pendingControllersCount;
+
+            // The event only wakes one of the init threads, hand whatever is left to another one
+            if (pendingControllersCount != 0)
+                ueventSignal(&g_pendingControllersEvent);
+            return true;
+        }
+
+        void ClearPendingControllers()
+        {
+            PendingController pending;
+            while (PopPendingController(&pending))
+            {
+                // Releases the acquired interfaces
+                pending.controller.reset();
+                controllers::ReleaseSlot(pending.slot);
+            }
+        }
+
+        // Identification runs on the USB event path, so it stays allocation and logging free
         ControllerType IdentifyControllerType(const UsbHsInterface *iface)
         {
-            WriteToLog("Checking controller -> vid: 0x%04x, pid: 0c%04x", iface->device_desc.idVendor, iface->device_desc.idProduct);
+            DeviceEntry entry;
+            if (!FindDeviceEntry(iface->device_desc.idVendor, iface->device_desc.idProduct, iface->inf.interface_desc.bInterfaceNumber, &entry))
+                return CONTROLLER_UNDEFINED;
+
+            return entry.type;
+        }
+
+        using CreateControllerFunc = std::unique_ptr<IController> (*)(std::unique_ptr<IUSBDevice> &&device);
+
+        template <typename T>
+        std::unique_ptr<IController> CreateController(std::unique_ptr<IUSBDevice> &&device)
+        {
+            return std::make_unique<T>(std::move(device));
+        }
+
+        struct InterfaceDispatch
+        {
+            u8 iclass;
+            u8 isubclass;
+            u8 iprotocol;
+            // CONTROLLER_UNDEFINED matches on the whole class triple. HID interfaces can't be told apart that way,
+            // so anything else matches on the interface class and the device's type in the device database
+            ControllerType type;
+            // Whether all the matching interfaces of a device make up one controller, or each of them is its own
+            bool groupByDevice;
+            CreateControllerFunc create;
+            const char *name;
+        };
+
+        constexpr InterfaceDispatch interfaceDispatchTable[] = {
+            {USB_CLASS_VENDOR_SPEC, 93, 1, CONTROLLER_UNDEFINED, true, &CreateController<Xbox360Controller>, "Xbox 360"},
+            {USB_CLASS_VENDOR_SPEC, 93, 129, CONTROLLER_UNDEFINED, false, &CreateController<Xbox360WirelessController>, "Xbox 360 wireless"},
+            {0x58, 0x42, 0x00, CONTROLLER_UNDEFINED, true, &CreateController<XboxController>, "Xbox Original"},
+            {USB_CLASS_VENDOR_SPEC, 71, 208, CONTROLLER_UNDEFINED, true, &CreateController<XboxOneController>, "Xbox One"},
+            {USB_CLASS_HID, 0, 0, CONTROLLER_DUALSHOCK3, false, &CreateController<Dualshock3Controller>, "Dualshock 3"},
+            {USB_CLASS_HID, 0, 0, CONTROLLER_DUALSHOCK4, false, &CreateController<Dualshock4Controller>, "Dualshock 4"},
+        };
+
+        const InterfaceDispatch *ClassifyInterface(const UsbHsInterface &iface)
+        {
+            const usb_interface_descriptor &desc = iface.inf.interface_desc;
+            ControllerType type = CONTROLLER_UNDEFINED;
+            bool typeChecked = false;
 
-            for (auto id : ps3_hardware_ids)
+            for (const InterfaceDispatch &dispatch : interfaceDispatchTable)
             {
-                if ((id.vendor_id == iface->device_desc.idVendor) && (id.product_id == iface->device_desc.idProduct))
+                if (dispatch.iclass != desc.bInterfaceClass)
+                    continue;
+
+                if (dispatch.type == CONTROLLER_UNDEFINED)
                 {
-                    return CONTROLLER_DUALSHOCK3;
+                    if (dispatch.isubclass == desc.bInterfaceSubClass && dispatch.iprotocol == desc.bInterfaceProtocol)
+                        return &dispatch;
+                    continue;
                 }
-            }
 
-            for (auto id : ps4_hardware_ids)
-            {
-                if ((id.vendor_id == iface->device_desc.idVendor) && (id.product_id == iface->device_desc.idProduct))
+                if (!typeChecked)
                 {
-                    return CONTROLLER_DUALSHOCK4;
+                    type = IdentifyControllerType(&iface);
+                    typeChecked = true;
                 }
-            }
 
-            return CONTROLLER_UNDEFINED;
+                if (dispatch.type == type)
+                    return &dispatch;
+            }
+            return nullptr;
         }
 
-        s32 QueryInterfaces(u8 iclass, u8 isubclass, u8 iprotocol);
-        // s32 QueryVendorProduct(uint16_t vendor_id, uint16_t product_id);
+        // Only touched by the event thread
+        UsbHsInterface availableInterfaces[MaxUsbHsInterfacesSize];
+        std::array<const InterfaceDispatch *, MaxUsbHsInterfacesSize> availableDispatch;
 
-        void UsbEventThreadFunc(void *)
+        bool IsSameDevice(const UsbHsInterface &a, const UsbHsInterface &b)
         {
-            do
+            return a.busID == b.busID && a.deviceID == b.deviceID;
+        }
+
+        // Hand the queried interfaces to their drivers, until there are no controller slots left
+        void DispatchInterfaces(s32 total_entries)
+        {
+            for (s32 i = 0; i != total_entries; ++i)
+                availableDispatch[i] = ClassifyInterface(availableInterfaces[i]);
+
+            for (s32 i = 0; i < total_entries;)
             {
-                if (R_SUCCEEDED(eventWait(&g_usbCatchAllEvent, UINT64_MAX)))
+                const InterfaceDispatch *dispatch = availableDispatch[i];
+                if (dispatch == nullptr)
                 {
-                    WriteToLog("Catch-all event went off");
+                    ++i;
+                    continue;
+                }
 
-                    /*
-                    Result rc;
+                // Move the rest of this device's interfaces for the same driver right behind this one.
+                // No supported controller has more than a handler can keep track of, the rest would be left unwatched
+                s32 count = 1;
+                if (dispatch->groupByDevice)
+                {
+                    for (s32 j = i + 1; j != total_entries && static_cast<size_t>(count) != SwitchVirtualGamepadHandler::MaxInterfaceIds; ++j)
+                    {
+                        if (availableDispatch[j] != dispatch || !IsSameDevice(availableInterfaces[i], availableInterfaces[j]))
+                            continue;
 
-                    UsbHsInterfaceFilter filter;
-                    filter.Flags = UsbHsInterfaceFilterFlags_bInterfaceClass | UsbHsInterfaceFilterFlags_bcdDevice_Min;
-                    filter.bInterfaceClass = USB_CLASS_HID;
-                    filter.bcdDevice_Min = 0;
-                    */
+                        std::swap(availableInterfaces[i + count], availableInterfaces[j]);
+                        std::swap(availableDispatch[i + count], availableDispatch[j]);
+                        ++count;
+                    }
+                }
 
-                    std::scoped_lock usbLock(usbMutex);
-                    if (!controllers::IsAtControllerLimit())
-                    {
-                        s32 total_entries = 0;
-
-                        /*
-                        rc = usbHsQueryAvailableInterfaces(&filter, interfaces, sizeof(interfaces), &total_entries);
-                        WriteToLog("%d interfaces found", total_entries);
-                        if (R_SUCCEEDED(rc) && (total_entries > 0)) {
-                            for (int i = 0; i < total_entries; ++i) {
-                                switch(IdentifyControllerType(&interfaces[i])) {
-                                    case CONTROLLER_DUALSHOCK3:
-                                        WriteToLog("Initializing Dualshock 3 controller: 0x%x", controllers::Insert(std::make_unique<Dualshock3Controller>(std::make_unique<SwitchUSBDevice>(&interfaces[i], 1))));
-                                        break;
-                                    case CONTROLLER_DUALSHOCK4:
-                                        WriteToLog("Initializing Dualshock 4 controller: 0x%x", controllers::Insert(std::make_unique<Dualshock4Controller>(std::make_unique<SwitchUSBDevice>(&interfaces[i], 1))));
-                                        break;
-                                    default:
-                                        break;
-                                }
-                            }
-                        }
-                        else {
-                            WriteToLog("rc: %d", rc);
-                        }
-                        */
+                // Every other controller would end up here too, so leave their interfaces alone for now
+                s32 slot = controllers::AcquireSlot();
+                if (slot == SwitchPadSlotAllocator::InvalidSlot)
+                {
+                    LOG_WARNING("No free controller slot, ignoring the remaining devices");
+                    return;
+                }
 
-                        if ((total_entries = QueryInterfaces(USB_CLASS_VENDOR_SPEC, 93, 1)) != 0)
-                        {
-                            ams::Result res = controllers::Insert(std::make_unique<Xbox360Controller>(std::make_unique<SwitchUSBDevice>(interfaces, total_entries)));
-                            WriteToLog("Initializing Xbox 360 controller: 0x%x", res.GetValue());
-                        }
+                QueueController(dispatch->create(std::make_unique<SwitchUSBDevice>(&availableInterfaces[i], count)), dispatch->name, slot);
+                i += count;
+            }
+        }
 
-                        if ((total_entries = QueryInterfaces(USB_CLASS_VENDOR_SPEC, 93, 129)) != 0)
-                            for (int i = 0; i != total_entries; ++i)
-                            {
-                                ams::Result res = controllers::Insert(std::make_unique<Xbox360WirelessController>(std::make_unique<SwitchUSBDevice>(interfaces + i, 1)));
-                                WriteToLog("Initializing Xbox 360 wireless controller: 0x%x", res.GetValue());
-                            }
+        void UsbEventThreadFunc(void *)
+        {
+            if (g_usb_event_thread.Wait(waiterForEvent(&g_usbCatchAllEvent)))
+            {
+                LOG_DEBUG("Catch-all event went off");
 
-                        if ((total_entries = QueryInterfaces(0x58, 0x42, 0x00)) != 0)
-                        {
-                            ams::Result res = controllers::Insert(std::make_unique<XboxController>(std::make_unique<SwitchUSBDevice>(interfaces, total_entries)));
-                            WriteToLog("Initializing Xbox Original controller: 0x%x", res.GetValue());
-                        }
+                if (controllers::IsAtControllerLimit())
+                    return;
 
-                        if ((total_entries = QueryInterfaces(USB_CLASS_VENDOR_SPEC, 71, 208)) != 0)
-                        {
-                            ams::Result res = controllers::Insert(std::make_unique<XboxOneController>(std::make_unique<SwitchUSBDevice>(interfaces, total_entries)));
-                            WriteToLog("Initializing Xbox One controller: 0x%x", res.GetValue());
-                        }
-                    }
-                }
-            } while (is_usb_event_thread_running);
+                // One query for everything, the interfaces are sorted out by the dispatch table
+                constexpr UsbHsInterfaceFilter filter{
+                    .Flags = UsbHsInterfaceFilterFlags_bcdDevice_Min,
+                    .bcdDevice_Min = 0,
+                };
+
+                s32 total_entries = 0;
+                if (R_FAILED(usbHsQueryAvailableInterfaces(&filter, availableInterfaces, sizeof(availableInterfaces), &total_entries)))
+                    return;
+
+                DispatchInterfaces(total_entries);
+            }
         }
 
-        void UsbSonyEventThreadFunc(void *)
+        struct HandlerSnapshot
         {
-            Result rc;
+            SwitchVirtualGamepadHandler *handler;
+            u32 generation;
+        };
+
+        struct HandlerInterfaceId
+        {
+            s32 id;
+            u8 handlerIndex;
+        };
+
+        constexpr size_t MaxHandlerInterfaceIdsSize = controllers::MaxControllerHandlersSize * SwitchVirtualGamepadHandler::MaxInterfaceIds;
 
-            UsbHsInterfaceFilter filter;
-            filter.Flags = UsbHsInterfaceFilterFlags_bInterfaceClass | UsbHsInterfaceFilterFlags_bcdDevice_Min;
-            filter.bInterfaceClass = USB_CLASS_HID;
-            filter.bcdDevice_Min = 0;
+        // Shared by the interface change thread and controllers::Resume, the interfaces are large
+        UsbHsInterface acquiredInterfaces[MaxAcquiredInterfacesSize];
+        ams::os::Mutex acquiredInterfacesMutex(false);
 
-            do
+        void UsbInterfaceChangeThreadFunc(void *)
+        {
+            s32 signaled = g_usb_interface_change_thread.WaitAny(waiterForEvent(usbHsGetInterfaceStateChangeEvent()), waiterForUEvent(&g_handlerLostEvent));
+            if (signaled != -1)
             {
-                if (R_SUCCEEDED(eventWait(&g_usbSonyEvent, UINT64_MAX)))
+                if (signaled == 0)
+                {
+                    LOG_DEBUG("Interface state was changed");
+                    eventClear(usbHsGetInterfaceStateChangeEvent());
+                }
+                else
+                    LOG_DEBUG("A controller gave up on its device");
+
+                // Snapshot the handlers before querying, so every handler in it already had its interfaces acquired.
+                // Handlers inserted after this are left alone until the next state change
+                std::array<HandlerSnapshot, controllers::MaxControllerHandlersSize> handlers;
+                std::array<HandlerInterfaceId, MaxHandlerInterfaceIdsSize> handlerIds;
+                size_t handlerCount = 0;
+                size_t handlerIdCount = 0;
                 {
-                    WriteToLog("Sony event went off");
+                    std::scoped_lock controllersLock(controllers::GetScopedLock());
+                    for (auto &&handler : controllers::Get())
+                    {
+                        if (handlerCount == handlers.size())
+                            break;
 
-                    std::scoped_lock usbLock(usbMutex);
-                    if (!controllers::IsAtControllerLimit())
+                        for (size_t i = 0; i != handler->GetInterfaceIdCount(); ++i)
+                            handlerIds[handlerIdCount++] = {handler->GetInterfaceIds()[i], static_cast<u8>(handlerCount)};
+                        handlers[handlerCount++] = {handler.get(), controllers::GetGeneration(handler.get())};
+                    }
+                }
+
+                std::array<s32, MaxAcquiredInterfacesSize> acquiredIds;
+                size_t total_entries = 0;
+                if (!QueryAcquiredInterfaceIds(acquiredIds.data(), acquiredIds.size(), &total_entries))
+                    return;
+
+                std::sort(handlerIds.begin(), handlerIds.begin() + handlerIdCount, [](const HandlerInterfaceId &a, const HandlerInterfaceId &b) {
+                    return a.id < b.id;
+                });
+
+                // We check if a device was removed by comparing the controller's interfaces and the currently acquired interfaces
+                // If we didn't find a single matching interface ID, we consider a controller removed
+                std::array<bool, controllers::MaxControllerHandlersSize> handlerFound{};
+                for (size_t h = 0, a = 0; h != handlerIdCount && a != total_entries;)
+                {
+                    if (handlerIds[h].id < acquiredIds[a])
+                        ++h;
+                    else if (acquiredIds[a] < handlerIds[h].id)
+                        ++a;
+                    else
+                        handlerFound[handlerIds[h++].handlerIndex] = true;
+                }
+
+                // Removed handlers are taken out of the list under the lock, but torn down after it's released,
+                // so waiting on their threads doesn't hold up discovery or the other controllers
+                std::array<controllers::HandlerPtr, controllers::MaxControllerHandlersSize> removed;
+                size_t removedCount = 0;
+                {
+                    std::scoped_lock controllersLock(controllers::GetScopedLock());
+                    auto &list = controllers::Get();
+                    for (auto it = list.begin(); it != list.end();)
                     {
-                        s32 total_entries = 0;
-                        rc = usbHsQueryAvailableInterfaces(&filter, interfaces, sizeof(interfaces), &total_entries);
-                        if (R_SUCCEEDED(rc) && (total_entries > 0))
+                        // A handler that was destroyed meanwhile may have been replaced by a new one in the same slot
+                        u32 generation = controllers::GetGeneration(it->get());
+                        auto snapshot = std::find_if(handlers.begin(), handlers.begin() + handlerCount, [&](const HandlerSnapshot &snapshot) {
+                            return snapshot.handler == it->get() && snapshot.generation == generation;
+                        });
+                        if (snapshot == handlers.begin() + handlerCount)
                         {
-                            for (int i = 0; i < total_entries; ++i)
-                            {
-                                switch (IdentifyControllerType(&interfaces[i]))
-                                {
-                                    case CONTROLLER_DUALSHOCK3:
-                                    {
-                                        ams::Result res = controllers::Insert(std::make_unique<Dualshock3Controller>(std::make_unique<SwitchUSBDevice>(&interfaces[i], 1)));
-                                        WriteToLog("Initializing Dualshock 3 controller: 0x%x", res.GetValue());
-                                    }
-                                    break;
-                                    case CONTROLLER_DUALSHOCK4:
-                                    {
-                                        ams::Result res = controllers::Insert(std::make_unique<Dualshock4Controller>(std::make_unique<SwitchUSBDevice>(&interfaces[i], 1)));
-                                        WriteToLog("Initializing Dualshock 4 controller: 0x%x", res.GetValue());
-                                    }
-                                    break;
-                                    default:
-                                        break;
-                                }
-                            }
+                            ++it;
+                            continue;
                         }
 
-                        /*
-                        if ((QueryVendorProduct(VENDOR_SONY, PRODUCT_DUALSHOCK3) != 0) && (total_entries = QueryInterfaces(USB_CLASS_HID, 0, 0)) != 0)
+                        // Handlers that gave up on their device are dropped too, so it can be picked up again if it's still there
+                        if (handlerFound[snapshot - handlers.begin()] && !(*it)->IsDeviceLost())
                         {
-                            ams::Result res = controllers::Insert(std::make_unique<Dualshock3Controller>(std::make_unique<SwitchUSBDevice>(interfaces, total_entries)));
-                            WriteToLog("Initializing Dualshock 3 controller: 0x%x", res.GetValue());
+                            ++it;
+                            continue;
                         }
-                        else if ((QueryVendorProduct(VENDOR_SONY, PRODUCT_DUALSHOCK4_1X) != 0 || QueryVendorProduct(VENDOR_SONY, PRODUCT_DUALSHOCK4_2X) != 0) && (total_entries = QueryInterfaces(USB_CLASS_HID, 0, 0)) != 0)
-                        {
-                            ams::Result res = controllers::Insert(std::make_unique<Dualshock4Controller>(std::make_unique<SwitchUSBDevice>(interfaces, total_entries)));
-                            WriteToLog("Initializing Dualshock 4 controller: 0x%x", res.GetValue());
-                        }
-                                                */
+
+                        removed[removedCount++] = std::move(*it);
+                        it = list.erase(it);
                     }
                 }
-            } while (is_usb_event_thread_running);
+
+                for (size_t i = 0; i != removedCount; ++i)
+                {
+                    LOG_DEBUG("Erasing controller");
+                    removed[i].reset();
+                    LOG_DEBUG("Controller erased!");
+                }
+            }
         }
 
-        void UsbInterfaceChangeThreadFunc(void *)
+        void UsbInitThreadFunc(void *argument)
         {
-            do
+            SwitchWorkerThread *thread = static_cast<SwitchWorkerThread *>(argument);
+            if (thread->Wait(waiterForUEvent(&g_pendingControllersEvent)))
             {
-                if (R_SUCCEEDED(eventWait(usbHsGetInterfaceStateChangeEvent(), UINT64_MAX)))
+                PendingController pending;
+                while (!thread->IsStopRequested() && PopPendingController(&pending))
                 {
-                    s32 total_entries;
-                    WriteToLog("Interface state was changed");
-
-                    std::scoped_lock usbLock(usbMutex);
-                    std::scoped_lock controllersLock(controllers::GetScopedLock());
-
-                    eventClear(usbHsGetInterfaceStateChangeEvent());
-                    memset(interfaces, 0, sizeof(interfaces));
-                    if (R_SUCCEEDED(usbHsQueryAcquiredInterfaces(interfaces, sizeof(interfaces), &total_entries)))
-                    {
-                        for (auto it = controllers::Get().begin(); it != controllers::Get().end(); ++it)
-                        {
-                            bool found_flag = false;
-
-                            for (auto &&ptr : (*it)->GetController()->GetDevice()->GetInterfaces())
-                            {
-                                // We check if a device was removed by comparing the controller's interfaces and the currently acquired interfaces
-                                // If we didn't find a single matching interface ID, we consider a controller removed
-                                for (int i = 0; i != total_entries; ++i)
-                                {
-                                    if (interfaces[i].inf.ID == static_cast<SwitchUSBInterface *>(ptr.get())->GetID())
-                                    {
-                                        found_flag = true;
-                                        break;
-                                    }
-                                }
-                            }
-
-                            if (!found_flag)
-                            {
-                                WriteToLog("Erasing controller");
-                                controllers::Get().erase(it--);
-                                WriteToLog("Controller erased!");
-                            }
-                        }
-                    }
+                    ams::Result res = controllers::Insert(std::move(pending.controller), pending.slot);
+                    LOG_INFO("Initializing %s controller: 0x%x", pending.name, res.GetValue());
                 }
-            } while (is_usb_interface_change_thread_running);
+            }
         }
 
-        s32 QueryInterfaces(u8 iclass, u8 isubclass, u8 iprotocol)
+        ams::Result StartThreads()
         {
-            UsbHsInterfaceFilter filter{
-                .Flags = UsbHsInterfaceFilterFlags_bInterfaceClass | UsbHsInterfaceFilterFlags_bInterfaceSubClass | UsbHsInterfaceFilterFlags_bInterfaceProtocol,
-                .bInterfaceClass = iclass,
-                .bInterfaceSubClass = isubclass,
-                .bInterfaceProtocol = iprotocol,
-            };
-            s32 out_entries = 0;
-            memset(interfaces, 0, sizeof(interfaces));
-            usbHsQueryAvailableInterfaces(&filter, interfaces, sizeof(interfaces), &out_entries);
-            return out_entries;
+            for (size_t i = 0; i != g_usb_init_threads.size(); ++i)
+                R_TRY(g_usb_init_threads[i].Start(&UsbInitThreadFunc, &g_usb_init_threads[i], usb_init_thread_stacks[i], sizeof(usb_init_thread_stacks[i]), 0x3B));
+            R_TRY(g_usb_event_thread.Start(&UsbEventThreadFunc, nullptr, usb_event_thread_stack, sizeof(usb_event_thread_stack), 0x3A));
+            R_TRY(g_usb_interface_change_thread.Start(&UsbInterfaceChangeThreadFunc, nullptr, usb_interface_change_thread_stack, sizeof(usb_interface_change_thread_stack), 0x2C));
+
+            R_SUCCEED();
         }
 
-        /*
-        s32 QueryVendorProduct(uint16_t vendor_id, uint16_t product_id)
+        // Returns once no thread is in the middle of inserting or removing a handler
+        void StopThreads()
         {
-            UsbHsInterfaceFilter filter{
-                .Flags = UsbHsInterfaceFilterFlags_idVendor | UsbHsInterfaceFilterFlags_idProduct,
-                .idVendor = vendor_id,
-                .idProduct = product_id,
-            };
-            s32 out_entries = 0;
-            usbHsQueryAvailableInterfaces(&filter, interfaces, sizeof(interfaces), &out_entries);
-            return out_entries;
+            // Ask all of them to stop first so they wind down in parallel
+            g_usb_event_thread.RequestStop();
+            g_usb_interface_change_thread.RequestStop();
+            for (auto &thread : g_usb_init_threads)
+                thread.RequestStop();
+
+            g_usb_event_thread.Join();
+            g_usb_interface_change_thread.Join();
+            for (auto &thread : g_usb_init_threads)
+                thread.Join();
+
+            ClearPendingControllers();
         }
-        */
 
         inline ams::Result CreateCatchAllAvailableEvent()
         {
@@ -333,20 +428,25 @@ namespace syscon::usb
             R_RETURN(usbHsCreateInterfaceAvailableEvent(&g_usbCatchAllEvent, true, CatchAllEventIndex, &filter));
         }
 
-        inline ams::Result CreateSonyAvailableEvent()
-        {
-            constexpr UsbHsInterfaceFilter filter{
-                //.Flags = UsbHsInterfaceFilterFlags_idVendor,
-                //.idVendor = VENDOR_SONY,
-                .Flags = UsbHsInterfaceFilterFlags_bInterfaceClass | UsbHsInterfaceFilterFlags_bcdDevice_Min,
-                .bcdDevice_Min = 0,
-                .bInterfaceClass = USB_CLASS_HID,
-            };
-            R_RETURN(usbHsCreateInterfaceAvailableEvent(&g_usbSonyEvent, true, SonyEventIndex, &filter));
-        }
-
     } // namespace
 
+    bool QueryAcquiredInterfaceIds(s32 *outIds, size_t maxIds, size_t *outCount)
+    {
+        std::scoped_lock lock(acquiredInterfacesMutex);
+
+        s32 total_entries = 0;
+        if (R_FAILED(usbHsQueryAcquiredInterfaces(acquiredInterfaces, sizeof(acquiredInterfaces), &total_entries)))
+            return false;
+
+        size_t count = std::min<size_t>(total_entries, maxIds);
+        for (size_t i = 0; i != count; ++i)
+            outIds[i] = acquiredInterfaces[i].inf.ID;
+        std::sort(outIds, outIds + count);
+
+        *outCount = count;
+        return true;
+    }
+
     ams::Result Initialize()
     {
         R_RETURN(Enable());
@@ -361,48 +461,39 @@ namespace syscon::usb
     {
         R_TRY(CreateUsbEvents());
 
-        is_usb_event_thread_running = true;
-        is_usb_interface_change_thread_running = true;
+        ueventCreate(&g_pendingControllersEvent, true);
+        ueventCreate(&g_handlerLostEvent, true);
+        SwitchVirtualGamepadHandler::SetDeviceLostCallback(&OnHandlerDeviceLost);
 
-        R_TRY(threadCreate(&g_usb_event_thread, &UsbEventThreadFunc, nullptr, usb_event_thread_stack, sizeof(usb_event_thread_stack), 0x3A, -2));
-        R_TRY(threadCreate(&g_sony_event_thread, &UsbSonyEventThreadFunc, nullptr, sony_event_thread_stack, sizeof(sony_event_thread_stack), 0x3B, -2));
-        R_TRY(threadCreate(&g_usb_interface_change_thread, &UsbInterfaceChangeThreadFunc, nullptr, usb_interface_change_thread_stack, sizeof(usb_interface_change_thread_stack), 0x2C, -2));
-
-        R_TRY(threadStart(&g_usb_event_thread));
-        R_TRY(threadStart(&g_sony_event_thread));
-        R_TRY(threadStart(&g_usb_interface_change_thread));
-
-        R_SUCCEED();
+        R_RETURN(StartThreads());
     }
 
     void Disable()
     {
-        is_usb_event_thread_running = false;
-        is_usb_interface_change_thread_running = false;
-
-        svcCancelSynchronization(g_usb_event_thread.handle);
-        threadWaitForExit(&g_usb_event_thread);
-        threadClose(&g_usb_event_thread);
-
-        svcCancelSynchronization(g_sony_event_thread.handle);
-        threadWaitForExit(&g_sony_event_thread);
-        threadClose(&g_sony_event_thread);
-
-        svcCancelSynchronization(g_usb_interface_change_thread.handle);
-        threadWaitForExit(&g_usb_interface_change_thread);
-        threadClose(&g_usb_interface_change_thread);
+        StopThreads();
 
         DestroyUsbEvents();
         controllers::Reset();
     }
 
+    void Suspend()
+    {
+        // Nothing may insert or remove a handler while they are suspended. A controller still waiting for init is dropped
+        // instead, its interfaces are released so it gets picked up again once we're awake
+        StopThreads();
+    }
+
+    ams::Result Resume()
+    {
+        R_RETURN(StartThreads());
+    }
+
     ams::Result CreateUsbEvents()
     {
         if (g_usbCatchAllEvent.revent != INVALID_HANDLE)
             R_RETURN(0x99);
 
         R_TRY(CreateCatchAllAvailableEvent());
-        R_TRY(CreateSonyAvailableEvent());
 
         R_SUCCEED();
     }
@@ -410,6 +501,5 @@ namespace syscon::usb
     void DestroyUsbEvents()
     {
         usbHsDestroyInterfaceAvailableEvent(&g_usbCatchAllEvent, CatchAllEventIndex);
-        usbHsDestroyInterfaceAvailableEvent(&g_usbSonyEvent, SonyEventIndex);
     }
 } // namespace syscon::usb
\ No newline at end of file
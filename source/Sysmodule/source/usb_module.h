@@ -1,5 +1,6 @@
 #pragma once
 #include <stratosphere.hpp>
+#include "controller_handler.h"
 
 namespace syscon::usb
 {
@@ -9,6 +10,16 @@ namespace syscon::usb
     ams::Result Enable();
     void Disable();
 
+    // Pause discovery and removal while the console sleeps, the usb events are kept
+    void Suspend();
+    ams::Result Resume();
+
+    // Every acquired interface belongs to a controller, which holds a handler slot from discovery on
+    constexpr size_t MaxAcquiredInterfacesSize = controllers::MaxControllerHandlersSize * SwitchVirtualGamepadHandler::MaxInterfaceIds;
+
+    // Get the sorted IDs of every interface that is currently acquired. Returns false if they couldn't be queried
+    bool QueryAcquiredInterfaceIds(s32 *outIds, size_t maxIds, size_t *outCount);
+
     ams::Result CreateUsbEvents();
     void DestroyUsbEvents();
 } // namespace syscon::usb
\ No newline at end of file
@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+# Turns the trace.bin written by sys-con (trace_events = true in config_global.ini) into readable text.
+# Usage: decode_trace.py trace.bin [--event NAME ...]
+import argparse
+import struct
+import sys
+
+HEADER = struct.Struct("<IHHQ")
+RECORD = struct.Struct("<QHBB3I")
+MAGIC = 0x52544353
+VERSION = 1
+
+
+def read_trace(data):
+    magic, version, event_count, tick_frequency = HEADER.unpack_from(data, 0)
+    if magic != MAGIC:
+        raise ValueError("not a sys-con trace file")
+    if version != VERSION:
+        raise ValueError(f"unsupported trace version {version}")
+
+    offset = HEADER.size
+    names = []
+    for _ in range(event_count):
+        length = data[offset]
+        names.append(data[offset + 1:offset + 1 + length].decode("ascii"))
+        offset += 1 + length
+
+    records = []
+    # A session that ended abruptly can leave half a record at the end
+    end = offset + (len(data) - offset) // RECORD.size * RECORD.size
+    for tick, event, ring, arg_count, *args in RECORD.iter_unpack(data[offset:end]):
+        name = names[event] if event < len(names) else f"Event{event}"
+        records.append((tick, ring, name, args[:arg_count]))
+
+    # Every thread writes to a ring of its own, so the records only come out ordered per thread
+    records.sort(key=lambda record: record[0])
+    return tick_frequency, records
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode a sys-con trace.bin")
+    parser.add_argument("trace")
+    parser.add_argument("--event", action="append", help="only show these events")
+    options = parser.parse_args()
+
+    with open(options.trace, "rb") as file:
+        tick_frequency, records = read_trace(file.read())
+
+    if not records:
+        return
+
+    start = records[0][0]
+    last_by_event = {}
+    for tick, ring, name, args in records:
+        if options.event and name not in options.event:
+            continue
+
+        # Time since the first record and since the previous record of the same event on the same thread
+        since_start = (tick - start) * 1e3 / tick_frequency
+        previous = last_by_event.get((ring, name))
+        delta = f"{(tick - previous) * 1e3 / tick_frequency:+10.3f} ms" if previous is not None else " " * 13
+        last_by_event[(ring, name)] = tick
+
+        formatted_args = " ".join(f"0x{arg:x}" if arg > 0xffff else str(arg) for arg in args)
+        sys.stdout.write(f"{since_start:12.3f} ms {delta}  [{ring:2}] {name:<14} {formatted_args}\n")
+
+
+if __name__ == "__main__":
+    main()